@@ -0,0 +1,38 @@
+#define STRICT_R_HEADERS
+#include "cpp11.hpp"
+#include "cpp11/R.hpp"
+
+#include "cpp11/simdjson.cpp"
+#include "cpp11/simdjson.h"
+#include <cpp11/parse_spec.hpp>
+#include <cpp11/simdjson_kernel.hpp>
+
+#include <chrono>
+
+// Returns the seconds of each of `n_iter` runs of the parser of `spec` on the
+// already padded `json`. Only iterating the document and `parse_json()` of the
+// top-level parser are timed, so the creation of the R objects is included.
+// The code is compiled with its own copy of simdjson, so the simdjson `kernel`
+// is set here rather than with `jsonparse:::set_simdjson_implementation()`.
+[[cpp11::register]]
+cpp11::writable::doubles bench_parse_spec(cpp11::strings json, cpp11::list spec, int n_iter, std::string kernel) {
+  set_simdjson_kernel(kernel);
+  simdjson::padded_string content = padded_json(json);
+  simdjson::ondemand::parser parser;
+  auto collector_ptr = parse_spec(spec);
+
+  cpp11::writable::doubles seconds(n_iter);
+  for (int i = 0; i < n_iter; i++) {
+    auto path = JSON_Path();
+    auto start = std::chrono::steady_clock::now();
+
+    simdjson::ondemand::document doc = parser.iterate(content);
+    simdjson::ondemand::value value = doc;
+    cpp11::sexp out = (*collector_ptr).parse_json(value, path);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    seconds[i] = elapsed.count();
+  }
+
+  return seconds;
+}
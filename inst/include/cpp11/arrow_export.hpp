@@ -0,0 +1,356 @@
+#pragma once
+
+#include "column_buffer.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Export of native column buffers via the Arrow C data interface, see
+// https://arrow.apache.org/docs/format/CDataInterface.html
+// The buffers are moved into the arrays, which own them until the consumer
+// calls `release`.
+
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+  const char* format;
+  const char* name;
+  const char* metadata;
+  int64_t flags;
+  int64_t n_children;
+  struct ArrowSchema** children;
+  struct ArrowSchema* dictionary;
+  void (*release)(struct ArrowSchema*);
+  void* private_data;
+};
+
+struct ArrowArray {
+  int64_t length;
+  int64_t null_count;
+  int64_t offset;
+  int64_t n_buffers;
+  int64_t n_children;
+  const void** buffers;
+  struct ArrowArray** children;
+  struct ArrowArray* dictionary;
+  void (*release)(struct ArrowArray*);
+  void* private_data;
+};
+
+#endif
+
+struct Arrow_Schema_Data {
+  std::string format;
+  std::string name;
+  std::vector<ArrowSchema*> children;
+  ArrowSchema* dictionary = nullptr;
+};
+
+inline void release_arrow_schema(ArrowSchema* schema) {
+  auto data = static_cast<Arrow_Schema_Data*>(schema->private_data);
+  for (ArrowSchema* child : data->children) {
+    if (child->release != nullptr) child->release(child);
+    delete child;
+  }
+  if (data->dictionary != nullptr) {
+    if (data->dictionary->release != nullptr) data->dictionary->release(data->dictionary);
+    delete data->dictionary;
+  }
+
+  delete data;
+  schema->release = nullptr;
+}
+
+struct Arrow_Array_Data {
+  std::vector<const void*> buffers;
+  std::vector<ArrowArray*> children;
+  ArrowArray* dictionary = nullptr;
+  std::vector<std::shared_ptr<void>> owned;
+
+  // keeps `x` alive as long as the array and returns its data
+  template <typename T>
+  inline const void* own(std::vector<T>&& x) {
+    auto ptr = std::make_shared<std::vector<T>>(std::move(x));
+    this->owned.push_back(ptr);
+    return ptr->data();
+  }
+
+  inline const void* own(std::string&& x) {
+    auto ptr = std::make_shared<std::string>(std::move(x));
+    this->owned.push_back(ptr);
+    return ptr->data();
+  }
+};
+
+inline void release_arrow_array(ArrowArray* array) {
+  auto data = static_cast<Arrow_Array_Data*>(array->private_data);
+  for (ArrowArray* child : data->children) {
+    if (child->release != nullptr) child->release(child);
+    delete child;
+  }
+  if (data->dictionary != nullptr) {
+    if (data->dictionary->release != nullptr) data->dictionary->release(data->dictionary);
+    delete data->dictionary;
+  }
+
+  delete data;
+  array->release = nullptr;
+}
+
+// `children` and `dictionary` are passed as `new`-allocated structs and owned by `schema`
+inline void init_arrow_schema(ArrowSchema* schema, std::string format, const std::string& name,
+                              std::vector<ArrowSchema*> children = {},
+                              ArrowSchema* dictionary = nullptr) {
+  auto data = new Arrow_Schema_Data();
+  data->format = std::move(format);
+  data->name = name;
+  data->children = std::move(children);
+  data->dictionary = dictionary;
+
+  schema->format = data->format.c_str();
+  schema->name = data->name.c_str();
+  schema->metadata = nullptr;
+  schema->flags = ARROW_FLAG_NULLABLE;
+  schema->n_children = data->children.size();
+  schema->children = data->children.data();
+  schema->dictionary = dictionary;
+  schema->release = &release_arrow_schema;
+  schema->private_data = data;
+}
+
+// `data` holds the buffers and is owned by `array` afterwards
+inline void init_arrow_array(ArrowArray* array, Arrow_Array_Data* data, int64_t length, int64_t null_count) {
+  array->length = length;
+  array->null_count = null_count;
+  array->offset = 0;
+  array->n_buffers = data->buffers.size();
+  array->n_children = data->children.size();
+  array->buffers = data->buffers.data();
+  array->children = data->children.data();
+  array->dictionary = data->dictionary;
+  array->release = &release_arrow_array;
+  array->private_data = data;
+}
+
+// the validity buffer; may be null if nothing is missing
+inline const void* export_validity(Arrow_Array_Data* data, Validity_Bitmap& validity) {
+  if (validity.get_null_count() == 0) {
+    return nullptr;
+  }
+
+  return data->own(validity.take_bits());
+}
+
+template <typename T>
+inline void export_arrow_fixed(Column_Buffer<T>& x, const char* format, const std::string& name,
+                               ArrowSchema* schema, ArrowArray* array) {
+  int64_t length = x.size();
+  int64_t null_count = x.get_validity().get_null_count();
+
+  auto data = new Arrow_Array_Data();
+  data->buffers.push_back(export_validity(data, x.get_validity()));
+  data->buffers.push_back(data->own(x.take_values()));
+
+  init_arrow_schema(schema, format, name);
+  init_arrow_array(array, data, length, null_count);
+}
+
+// booleans are stored as one bit per value
+inline void export_arrow_bool(Column_Buffer<int32_t>& x, const std::string& name,
+                              ArrowSchema* schema, ArrowArray* array) {
+  int64_t length = x.size();
+  int64_t null_count = x.get_validity().get_null_count();
+
+  std::vector<uint8_t> bits((length + 7) / 8, 0);
+  const int32_t* values = x.data();
+  for (int64_t i = 0; i < length; i++) {
+    if (values[i] == 1) bits[i >> 3] |= static_cast<uint8_t>(1 << (i & 7));
+  }
+
+  auto data = new Arrow_Array_Data();
+  data->buffers.push_back(export_validity(data, x.get_validity()));
+  data->buffers.push_back(data->own(std::move(bits)));
+
+  init_arrow_schema(schema, "b", name);
+  init_arrow_array(array, data, length, null_count);
+}
+
+inline void export_arrow_string(String_Buffer& x, const std::string& name,
+                                ArrowSchema* schema, ArrowArray* array) {
+  int64_t length = x.size();
+  int64_t null_count = x.get_validity().get_null_count();
+
+  auto data = new Arrow_Array_Data();
+  data->buffers.push_back(export_validity(data, x.get_validity()));
+  data->buffers.push_back(data->own(x.take_offsets()));
+  data->buffers.push_back(data->own(x.take_chars()));
+
+  init_arrow_schema(schema, "U", name);
+  init_arrow_array(array, data, length, null_count);
+}
+
+// dictionary encoded strings: int32 indices into the distinct values
+inline void export_arrow_dictionary(String_Buffer& x, const std::string& name,
+                                    ArrowSchema* schema, ArrowArray* array) {
+  int64_t length = x.size();
+  int64_t null_count = x.get_validity().get_null_count();
+  const Validity_Bitmap& validity = x.get_validity();
+
+  std::unordered_map<std::string_view, int32_t> index;
+  String_Buffer dictionary;
+  std::vector<int32_t> indices(length, 0);
+  for (int64_t i = 0; i < length; i++) {
+    if (!validity.is_valid(i)) continue;
+
+    auto it = index.emplace(x.get(i), static_cast<int32_t>(dictionary.size()));
+    if (it.second) {
+      dictionary.push_back(x.get(i));
+    }
+    indices[i] = (*it.first).second;
+  }
+
+  auto dictionary_schema = new ArrowSchema();
+  auto dictionary_array = new ArrowArray();
+  export_arrow_string(dictionary, "", dictionary_schema, dictionary_array);
+
+  auto data = new Arrow_Array_Data();
+  data->buffers.push_back(export_validity(data, x.get_validity()));
+  data->buffers.push_back(data->own(std::move(indices)));
+  data->dictionary = dictionary_array;
+
+  init_arrow_schema(schema, "i", name, {}, dictionary_schema);
+  init_arrow_array(array, data, length, null_count);
+}
+
+// seconds since 1970-01-01 UTC as a microsecond timestamp
+inline void export_arrow_timestamp(Column_Buffer<double>& x, const std::string& name,
+                                   ArrowSchema* schema, ArrowArray* array) {
+  int64_t length = x.size();
+  int64_t null_count = x.get_validity().get_null_count();
+
+  std::vector<int64_t> micros(length);
+  const double* values = x.data();
+  for (int64_t i = 0; i < length; i++) {
+    micros[i] = std::isnan(values[i]) ? 0 : std::llround(values[i] * 1e6);
+  }
+
+  auto data = new Arrow_Array_Data();
+  data->buffers.push_back(export_validity(data, x.get_validity()));
+  data->buffers.push_back(data->own(std::move(micros)));
+
+  init_arrow_schema(schema, "tsu:UTC", name);
+  init_arrow_array(array, data, length, null_count);
+}
+
+// days since 1970-01-01 as date32
+inline void export_arrow_date(Column_Buffer<double>& x, const std::string& name,
+                              ArrowSchema* schema, ArrowArray* array) {
+  int64_t length = x.size();
+  int64_t null_count = x.get_validity().get_null_count();
+
+  std::vector<int32_t> days(length);
+  const double* values = x.data();
+  for (int64_t i = 0; i < length; i++) {
+    days[i] = std::isnan(values[i]) ? 0 : static_cast<int32_t>(values[i]);
+  }
+
+  auto data = new Arrow_Array_Data();
+  data->buffers.push_back(export_validity(data, x.get_validity()));
+  data->buffers.push_back(data->own(std::move(days)));
+
+  init_arrow_schema(schema, "tdD", name);
+  init_arrow_array(array, data, length, null_count);
+}
+
+// `n_children` empty children are allocated and have to be filled by the caller
+inline void export_arrow_struct(int64_t length, const std::string& name, size_t n_children,
+                                ArrowSchema* schema, ArrowArray* array) {
+  std::vector<ArrowSchema*> child_schemas;
+  auto data = new Arrow_Array_Data();
+  data->buffers.push_back(nullptr);
+  for (size_t i = 0; i < n_children; i++) {
+    child_schemas.push_back(new ArrowSchema());
+    data->children.push_back(new ArrowArray());
+  }
+
+  init_arrow_schema(schema, "+s", name, std::move(child_schemas));
+  init_arrow_array(array, data, length, 0);
+}
+
+// A large list with `offsets.size() - 1` entries. The empty child for the
+// values is allocated and has to be filled by the caller.
+inline void export_arrow_list(std::vector<int64_t>&& offsets, Validity_Bitmap& validity, const std::string& name,
+                              ArrowSchema* schema, ArrowArray* array) {
+  int64_t length = offsets.size() - 1;
+  int64_t null_count = validity.get_null_count();
+
+  auto data = new Arrow_Array_Data();
+  data->buffers.push_back(export_validity(data, validity));
+  data->buffers.push_back(data->own(std::move(offsets)));
+  data->children.push_back(new ArrowArray());
+
+  init_arrow_schema(schema, "+L", name, {new ArrowSchema()});
+  init_arrow_array(array, data, length, null_count);
+}
+
+// A large list view: entry `i` has the `sizes[i]` values from `offsets[i]` on,
+// so that the entries don't have to cover the values without gaps. The empty
+// child for the values is allocated and has to be filled by the caller.
+inline void export_arrow_list_view(std::vector<int64_t>&& offsets, std::vector<int64_t>&& sizes,
+                                   Validity_Bitmap& validity, const std::string& name,
+                                   ArrowSchema* schema, ArrowArray* array) {
+  int64_t length = offsets.size();
+  int64_t null_count = validity.get_null_count();
+
+  auto data = new Arrow_Array_Data();
+  data->buffers.push_back(export_validity(data, validity));
+  data->buffers.push_back(data->own(std::move(offsets)));
+  data->buffers.push_back(data->own(std::move(sizes)));
+  data->children.push_back(new ArrowArray());
+
+  init_arrow_schema(schema, "+vL", name, {new ArrowSchema()});
+  init_arrow_array(array, data, length, null_count);
+}
+
+template <typename T>
+inline void export_arrow_values(typename Native_Buffer<T>::type& x, const std::string& name, bool dictionary,
+                                ArrowSchema* schema, ArrowArray* array);
+
+template <>
+inline void export_arrow_values<bool>(Column_Buffer<int32_t>& x, const std::string& name, bool /* dictionary */,
+                                      ArrowSchema* schema, ArrowArray* array) {
+  export_arrow_bool(x, name, schema, array);
+}
+
+template <>
+inline void export_arrow_values<int>(Column_Buffer<int32_t>& x, const std::string& name, bool /* dictionary */,
+                                     ArrowSchema* schema, ArrowArray* array) {
+  export_arrow_fixed(x, "i", name, schema, array);
+}
+
+template <>
+inline void export_arrow_values<double>(Column_Buffer<double>& x, const std::string& name, bool /* dictionary */,
+                                        ArrowSchema* schema, ArrowArray* array) {
+  export_arrow_fixed(x, "g", name, schema, array);
+}
+
+template <>
+inline void export_arrow_values<std::string>(String_Buffer& x, const std::string& name, bool dictionary,
+                                             ArrowSchema* schema, ArrowArray* array) {
+  if (dictionary) {
+    export_arrow_dictionary(x, name, schema, array);
+  } else {
+    export_arrow_string(x, name, schema, array);
+  }
+}
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Native storage for a column while it is parsed. Nothing in here touches R;
+// the buffers are turned into R vectors in one pass at the end (see
+// `materialize.hpp`).
+
+// Validity bitmap as in the Arrow columnar format: bit `i` (least significant
+// bit first) is set if value `i` is not missing.
+class Validity_Bitmap {
+private:
+  std::vector<uint8_t> bits;
+  int64_t length = 0;
+  int64_t null_count = 0;
+
+public:
+  inline void reset(int64_t n) {
+    this->bits.clear();
+    this->bits.reserve((n + 7) / 8);
+    this->length = 0;
+    this->null_count = 0;
+  }
+
+  inline void push_back(bool valid) {
+    if ((this->length & 7) == 0) {
+      this->bits.push_back(0);
+    }
+    if (valid) {
+      this->bits.back() |= static_cast<uint8_t>(1 << (this->length & 7));
+    } else {
+      this->null_count++;
+    }
+    this->length++;
+  }
+
+  inline void pop_back() {
+    this->length--;
+    if (this->is_valid(this->length)) {
+      this->bits.back() &= static_cast<uint8_t>(~(1 << (this->length & 7)));
+    } else {
+      this->null_count--;
+    }
+    if ((this->length & 7) == 0) {
+      this->bits.pop_back();
+    }
+  }
+
+  inline bool is_valid(int64_t i) const {
+    return (this->bits[i >> 3] >> (i & 7)) & 1;
+  }
+
+  inline int64_t size() const {
+    return this->length;
+  }
+
+  inline int64_t get_null_count() const {
+    return this->null_count;
+  }
+
+  inline const uint8_t* data() const {
+    return this->bits.data();
+  }
+
+  inline int64_t capacity_bytes() const {
+    return this->bits.capacity();
+  }
+
+  // moves the bits out, e.g. into an Arrow array; call `reset()` before reuse
+  inline std::vector<uint8_t> take_bits() {
+    return std::move(this->bits);
+  }
+};
+
+// The missing values use the same bit patterns as R's `NA_integer_`,
+// `NA_real_` (any NaN) and bit64's `NA_integer64_`.
+inline bool is_missing_value(int32_t x) {
+  return x == std::numeric_limits<int32_t>::min();
+}
+
+inline bool is_missing_value(double x) {
+  return std::isnan(x);
+}
+
+inline bool is_missing_value(int64_t x) {
+  return x == std::numeric_limits<int64_t>::min();
+}
+
+// Fixed width values. Missing values are stored as their sentinel and also
+// cleared in the validity bitmap.
+template <typename T>
+class Column_Buffer {
+private:
+  std::vector<T> values;
+  Validity_Bitmap validity;
+
+public:
+  // clears the buffer and makes room for `n` values
+  inline void reset(int64_t n) {
+    this->values.clear();
+    this->values.reserve(n);
+    this->validity.reset(n);
+  }
+
+  inline void push_back(T x) {
+    this->values.push_back(x);
+    this->validity.push_back(!is_missing_value(x));
+  }
+
+  inline void pop_back() {
+    this->values.pop_back();
+    this->validity.pop_back();
+  }
+
+  // appends all values of `other`
+  inline void append(const Column_Buffer<T>& other) {
+    for (int64_t i = 0; i < other.size(); i++) {
+      this->push_back(other.values[i]);
+    }
+  }
+
+  inline int64_t size() const {
+    return this->values.size();
+  }
+
+  inline const T* data() const {
+    return this->values.data();
+  }
+
+  // the bytes allocated for the buffer, which can be more than are used
+  inline int64_t capacity_bytes() const {
+    return this->values.capacity() * sizeof(T) + this->validity.capacity_bytes();
+  }
+
+  inline const Validity_Bitmap& get_validity() const {
+    return this->validity;
+  }
+
+  inline Validity_Bitmap& get_validity() {
+    return this->validity;
+  }
+
+  // moves the values out, e.g. into an Arrow array; call `reset()` before reuse
+  inline std::vector<T> take_values() {
+    return std::move(this->values);
+  }
+};
+
+// Variable length strings as one block of UTF-8 bytes and `size() + 1`
+// offsets into it; the bytes of value `i` are `[offsets[i], offsets[i + 1])`.
+class String_Buffer {
+private:
+  std::string chars;
+  std::vector<int64_t> offsets = {0};
+  Validity_Bitmap validity;
+
+public:
+  inline void reset(int64_t n) {
+    this->chars.clear();
+    this->offsets.clear();
+    this->offsets.reserve(n + 1);
+    this->offsets.push_back(0);
+    this->validity.reset(n);
+  }
+
+  inline void push_back(std::string_view x) {
+    this->chars.append(x.data(), x.size());
+    this->offsets.push_back(this->chars.size());
+    this->validity.push_back(true);
+  }
+
+  // Appends a value that `write(chars)` writes directly to the end of the
+  // bytes, e.g. while unescaping it. If `write()` returns `false` its bytes are
+  // dropped and no value is added.
+  template <typename F>
+  inline bool push_back_with(F write) {
+    size_t size = this->chars.size();
+    if (!write(this->chars)) {
+      this->chars.resize(size);
+      return false;
+    }
+
+    this->offsets.push_back(this->chars.size());
+    this->validity.push_back(true);
+    return true;
+  }
+
+  inline void push_null() {
+    this->offsets.push_back(this->chars.size());
+    this->validity.push_back(false);
+  }
+
+  inline void pop_back() {
+    this->offsets.pop_back();
+    this->chars.resize(this->offsets.back());
+    this->validity.pop_back();
+  }
+
+  inline int64_t size() const {
+    return this->offsets.size() - 1;
+  }
+
+  // appends all values of `other`
+  inline void append(const String_Buffer& other) {
+    for (int64_t i = 0; i < other.size(); i++) {
+      if (other.validity.is_valid(i)) {
+        this->push_back(other.get(i));
+      } else {
+        this->push_null();
+      }
+    }
+  }
+
+  inline std::string_view get(int64_t i) const {
+    return std::string_view(this->chars.data() + this->offsets[i], this->offsets[i + 1] - this->offsets[i]);
+  }
+
+  inline const char* chars_data() const {
+    return this->chars.data();
+  }
+
+  inline const int64_t* offsets_data() const {
+    return this->offsets.data();
+  }
+
+  inline int64_t capacity_bytes() const {
+    return this->chars.capacity() + this->offsets.capacity() * sizeof(int64_t) + this->validity.capacity_bytes();
+  }
+
+  inline const Validity_Bitmap& get_validity() const {
+    return this->validity;
+  }
+
+  inline Validity_Bitmap& get_validity() {
+    return this->validity;
+  }
+
+  inline std::string take_chars() {
+    return std::move(this->chars);
+  }
+
+  inline std::vector<int64_t> take_offsets() {
+    return std::move(this->offsets);
+  }
+};
+
+// the native buffer used for values of type `T`
+template <typename T>
+struct Native_Buffer {
+  using type = Column_Buffer<T>;
+};
+
+template <>
+struct Native_Buffer<bool> {
+  using type = Column_Buffer<int32_t>;
+};
+
+template <>
+struct Native_Buffer<int> {
+  using type = Column_Buffer<int32_t>;
+};
+
+template <>
+struct Native_Buffer<std::string> {
+  using type = String_Buffer;
+};
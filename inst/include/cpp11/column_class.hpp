@@ -2,6 +2,12 @@
 
 #define STRICT_R_HEADERS
 #include "parser_class.hpp"
+#include "nested_df.hpp"
+
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 
 template <typename T>
 class Column_Scalar : public virtual Column {
@@ -11,29 +17,20 @@ template <>
 class Column_Scalar<bool> : public virtual Column {
 protected:
   int default_val;
-  SEXP out;
-  int* out_data;
+  Column_Buffer<int32_t> buffer;
   bool added_value = false;
-  bool needs_unprotect = false;
 
 public:
   Column_Scalar(int default_val) {
     this->default_val = default_val;
   }
 
-  ~Column_Scalar() {
-    if (needs_unprotect) UNPROTECT(1);
-  }
-
   inline void reserve(int n) {
-    this->out = PROTECT(Rf_allocVector(LGLSXP, n));
-    this->out_data = LOGICAL(out);
-    this->needs_unprotect = true;
+    this->buffer.reset(n);
   }
 
   inline void add_value(simdjson::ondemand::value json, JSON_Path& path) {
-    *this->out_data = parse_scalar_bool(json, path);
-    ++this->out_data;
+    this->buffer.push_back(parse_scalar_bool(json, path));
     this->added_value = true;
   }
 
@@ -41,15 +38,27 @@ public:
     if (this->added_value) {
       this->added_value = false;
     }  else {
-      *this->out_data = this->default_val;
-      ++this->out_data;
+      this->buffer.push_back(this->default_val);
+    }
+  }
+
+  inline void discard_row() {
+    if (this->added_value) {
+      this->buffer.pop_back();
+      this->added_value = false;
     }
   }
 
+  inline int64_t buffer_bytes() {
+    return this->buffer.capacity_bytes();
+  }
+
   inline SEXP get_value() {
-    UNPROTECT(1);
-    this->needs_unprotect = false;
-    return this->out;
+    return materialize_logical(this->buffer);
+  }
+
+  inline void export_arrow(const std::string& name, bool dictionary, ArrowSchema* schema, ArrowArray* array) {
+    export_arrow_values<bool>(this->buffer, name, dictionary, schema, array);
   }
 };
 
@@ -57,29 +66,20 @@ template <>
 class Column_Scalar<int> : public virtual Column {
 protected:
   int default_val;
-  SEXP out;
-  int* out_data;
+  Column_Buffer<int32_t> buffer;
   bool added_value = false;
-  bool needs_unprotect = false;
 
 public:
   Column_Scalar(int default_val) {
     this->default_val = default_val;
   }
 
-  ~Column_Scalar() {
-    if (needs_unprotect) UNPROTECT(1);
-  }
-
   inline void reserve(int n) {
-    this->out = PROTECT(Rf_allocVector(INTSXP, n));
-    this->out_data = INTEGER(out);
-    this->needs_unprotect = true;
+    this->buffer.reset(n);
   }
 
   inline void add_value(simdjson::ondemand::value json, JSON_Path& path) {
-    *this->out_data = parse_scalar_int(json, path);
-    ++this->out_data;
+    this->buffer.push_back(parse_number<int>(json, path));
     this->added_value = true;
   }
 
@@ -87,15 +87,27 @@ public:
     if (this->added_value) {
       this->added_value = false;
     }  else {
-      *this->out_data = this->default_val;
-      ++this->out_data;
+      this->buffer.push_back(this->default_val);
     }
   }
 
+  inline void discard_row() {
+    if (this->added_value) {
+      this->buffer.pop_back();
+      this->added_value = false;
+    }
+  }
+
+  inline int64_t buffer_bytes() {
+    return this->buffer.capacity_bytes();
+  }
+
   inline SEXP get_value() {
-    UNPROTECT(1);
-    this->needs_unprotect = false;
-    return this->out;
+    return materialize_integer(this->buffer);
+  }
+
+  inline void export_arrow(const std::string& name, bool dictionary, ArrowSchema* schema, ArrowArray* array) {
+    export_arrow_values<int>(this->buffer, name, dictionary, schema, array);
   }
 };
 
@@ -103,29 +115,20 @@ template <>
 class Column_Scalar<double> : public virtual Column {
 protected:
   double default_val;
-  SEXP out;
-  double* out_data;
+  Column_Buffer<double> buffer;
   bool added_value = false;
-  bool needs_unprotect = false;
 
 public:
   Column_Scalar(double default_val) {
     this->default_val = default_val;
   }
 
-  ~Column_Scalar() {
-    if (needs_unprotect) UNPROTECT(1);
-  }
-
   inline void reserve(int n) {
-    this->out = PROTECT(Rf_allocVector(REALSXP, n));
-    this->out_data = REAL(out);
-    this->needs_unprotect = true;
+    this->buffer.reset(n);
   }
 
   inline void add_value(simdjson::ondemand::value json, JSON_Path& path) {
-    *this->out_data = parse_scalar_double(json, path);
-    ++this->out_data;
+    this->buffer.push_back(parse_number<double>(json, path));
     this->added_value = true;
   }
 
@@ -133,52 +136,107 @@ public:
     if (this->added_value) {
       this->added_value = false;
     }  else {
-      *this->out_data = this->default_val;
-      ++this->out_data;
+      this->buffer.push_back(this->default_val);
     }
   }
 
+  inline void discard_row() {
+    if (this->added_value) {
+      this->buffer.pop_back();
+      this->added_value = false;
+    }
+  }
+
+  inline int64_t buffer_bytes() {
+    return this->buffer.capacity_bytes();
+  }
+
   inline SEXP get_value() {
-    UNPROTECT(1);
-    this->needs_unprotect = false;
-    return this->out;
+    return materialize_double(this->buffer);
+  }
+
+  inline void export_arrow(const std::string& name, bool dictionary, ArrowSchema* schema, ArrowArray* array) {
+    export_arrow_values<double>(this->buffer, name, dictionary, schema, array);
   }
 };
 
 template <>
 class Column_Scalar<std::string> : public virtual Column {
 protected:
-  SEXP default_val;
-  SEXP out;
-  SEXP* out_data;
+  std::string default_val;
+  bool default_is_na;
+  String_Buffer buffer;
   bool added_value = false;
-  bool needs_unprotect = false;
 
 public:
-  // TODO simplify constructor to just use SEXP
   Column_Scalar(std::string default_val) {
-    // TODO could probably be done nicer
-    if (cpp11::is_na(cpp11::r_string(default_val))) {
-      this->default_val = R_NaString;
+    this->default_is_na = cpp11::is_na(cpp11::r_string(default_val));
+    this->default_val = default_val;
+  }
+
+  inline void reserve(int n) {
+    this->buffer.reset(n);
+  }
+
+  inline void add_value(simdjson::ondemand::value json, JSON_Path& path) {
+    append_scalar_string(this->buffer, json, path);
+    this->added_value = true;
+  }
+
+  inline void finalize_row() {
+    if (this->added_value) {
+      this->added_value = false;
+    }  else if (this->default_is_na) {
+      this->buffer.push_null();
     } else {
-      this->default_val = Rf_mkChar(std::string(default_val).c_str());
+      this->buffer.push_back(this->default_val);
+    }
+  }
+
+  inline void discard_row() {
+    if (this->added_value) {
+      this->buffer.pop_back();
+      this->added_value = false;
     }
   }
 
-  ~Column_Scalar() {
-    if (needs_unprotect) UNPROTECT(1);
+  inline int64_t buffer_bytes() {
+    return this->buffer.capacity_bytes();
+  }
+
+  inline SEXP get_value() {
+    return materialize_character(this->buffer);
+  }
+
+  inline void export_arrow(const std::string& name, bool dictionary, ArrowSchema* schema, ArrowArray* array) {
+    export_arrow_values<std::string>(this->buffer, name, dictionary, schema, array);
+  }
+};
+
+// A double column of class `POSIXct` (UTC) or `Date` parsed from ISO 8601 strings.
+class Column_Datetime : public virtual Column {
+protected:
+  double default_val;
+  bool is_date;
+  Column_Buffer<double> buffer;
+  bool added_value = false;
+
+public:
+  Column_Datetime(double default_val, bool is_date) {
+    this->default_val = default_val;
+    this->is_date = is_date;
   }
 
   inline void reserve(int n) {
-    this->out = PROTECT(Rf_allocVector(STRSXP, n));
-    this->out_data = STRING_PTR(out);
-    this->needs_unprotect = true;
+    this->buffer.reset(n);
   }
 
   inline void add_value(simdjson::ondemand::value json, JSON_Path& path) {
-    // TODO should this use SET_STRING_ELT
-    *this->out_data = parse_scalar_string(json, path);
-    ++this->out_data;
+    if (this->is_date) {
+      this->buffer.push_back(parse_scalar_date(json, path));
+    } else {
+      this->buffer.push_back(parse_scalar_datetime(json, path));
+    }
     this->added_value = true;
   }
 
@@ -186,68 +244,632 @@ public:
     if (this->added_value) {
       this->added_value = false;
     }  else {
-      *this->out_data = this->default_val;
-      ++this->out_data;
+      this->buffer.push_back(this->default_val);
+    }
+  }
+
+  inline void discard_row() {
+    if (this->added_value) {
+      this->buffer.pop_back();
+      this->added_value = false;
     }
   }
 
+  inline int64_t buffer_bytes() {
+    return this->buffer.capacity_bytes();
+  }
+
   inline SEXP get_value() {
+    SEXP out = PROTECT(materialize_double(this->buffer));
+    if (this->is_date) {
+      set_date_class(out);
+    } else {
+      set_datetime_class(out);
+    }
+
     UNPROTECT(1);
-    this->needs_unprotect = false;
-    return this->out;
+    return out;
+  }
+
+  inline void export_arrow(const std::string& name, bool /* dictionary */, ArrowSchema* schema, ArrowArray* array) {
+    if (this->is_date) {
+      export_arrow_date(this->buffer, name, schema, array);
+    } else {
+      export_arrow_timestamp(this->buffer, name, schema, array);
+    }
   }
 };
 
+// Epoch numbers in a fixed unit converted to a `POSIXct` column or, to keep
+// nanoseconds exactly, to an `integer64` column of nanoseconds.
+class Column_Epoch : public virtual Column {
+protected:
+  int64_t units_per_second;
+  bool as_integer64;
+  double default_val;
+  Column_Buffer<double> seconds;
+  Column_Buffer<int64_t> nanoseconds;
+  bool added_value = false;
+
+public:
+  // `default_val` is in seconds, or in nanoseconds for `as_integer64`
+  Column_Epoch(const std::string& unit, bool as_integer64, double default_val) {
+    this->units_per_second = epoch_units_per_second(unit);
+    this->as_integer64 = as_integer64;
+    this->default_val = default_val;
+  }
 
+  inline void reserve(int n) {
+    if (this->as_integer64) {
+      this->nanoseconds.reset(n);
+    } else {
+      this->seconds.reset(n);
+    }
+  }
+
+  inline void add_value(simdjson::ondemand::value json, JSON_Path& path) {
+    if (this->as_integer64) {
+      this->nanoseconds.push_back(parse_scalar_epoch_ns(json, this->units_per_second, path));
+    } else {
+      this->seconds.push_back(parse_scalar_epoch(json, this->units_per_second, path));
+    }
+    this->added_value = true;
+  }
+
+  inline void finalize_row() {
+    if (this->added_value) {
+      this->added_value = false;
+    }  else if (this->as_integer64) {
+      this->nanoseconds.push_back(ISNAN(this->default_val) ? NA_INTEGER64 : static_cast<int64_t>(this->default_val));
+    } else {
+      this->seconds.push_back(this->default_val);
+    }
+  }
+
+  inline void discard_row() {
+    if (this->added_value) {
+      if (this->as_integer64) {
+        this->nanoseconds.pop_back();
+      } else {
+        this->seconds.pop_back();
+      }
+      this->added_value = false;
+    }
+  }
+
+  inline int64_t buffer_bytes() {
+    return this->seconds.capacity_bytes() + this->nanoseconds.capacity_bytes();
+  }
+
+  inline SEXP get_value() {
+    SEXP out;
+    if (this->as_integer64) {
+      out = PROTECT(materialize_integer64(this->nanoseconds));
+      set_integer64_class(out);
+    } else {
+      out = PROTECT(materialize_double(this->seconds));
+      set_datetime_class(out);
+    }
+
+    UNPROTECT(1);
+    return out;
+  }
+
+  inline void export_arrow(const std::string& name, bool /* dictionary */, ArrowSchema* schema, ArrowArray* array) {
+    if (this->as_integer64) {
+      export_arrow_fixed(this->nanoseconds, "tsn:UTC", name, schema, array);
+    } else {
+      export_arrow_timestamp(this->seconds, name, schema, array);
+    }
+  }
+};
+
+// Starts as an integer column and promotes itself to double or to string when
+// it meets a value that does not fit. Already parsed rows are rewritten once
+// per promotion; numbers become strings as they are written in the JSON. The
+// default only fills rows without a value, so it doesn't change the type.
+class Column_Adaptive : public virtual Column {
+protected:
+  enum class Adaptive_Type {int_, dbl, str};
+
+  cpp11::sexp default_val;
+  cpp11::sexp out;
+  Adaptive_Type type = Adaptive_Type::int_;
+  int i = 0;
+  int n = 0;
+  bool added_value = false;
+  // The JSON text of the numbers until the column becomes a string column, as
+  // views into the input document, which outlives the parse. An empty view is
+  // a row without a number.
+  std::vector<std::string_view> tokens;
+  std::vector<int> default_rows;
+
+  inline void promote_to_double() {
+    SEXP new_out = Rf_allocVector(REALSXP, this->n);
+    double* pnew = REAL(new_out);
+    const int* pold = INTEGER(this->out);
+    for (int j = 0; j < this->i; j++) {
+      pnew[j] = (pold[j] == NA_INTEGER) ? NA_REAL : static_cast<double>(pold[j]);
+    }
+
+    this->out = new_out;
+    this->type = Adaptive_Type::dbl;
+  }
+
+  inline void promote_to_string() {
+    this->out = Rf_allocVector(STRSXP, this->n);
+    SEXP new_out = this->out;
+
+    for (int j = 0; j < this->i; j++) {
+      std::string_view token = this->tokens[j];
+      if (token.empty()) {
+        SET_STRING_ELT(new_out, j, NA_STRING);
+      } else {
+        SET_STRING_ELT(new_out, j, mk_utf8_char(trim_token(token)));
+      }
+    }
+
+    std::vector<std::string_view>().swap(this->tokens);
+    this->type = Adaptive_Type::str;
+  }
+
+  // `reserve()` is only a hint, e.g. for the rows of an unnested `df_vec`
+  inline void grow_if_full() {
+    if (this->i == this->n) {
+      this->out = grow_vector(this->out, this->i + 1);
+      this->n = Rf_xlength(this->out);
+    }
+  }
+
+  inline void write_na() {
+    this->grow_if_full();
+    switch (this->type) {
+    case Adaptive_Type::int_:
+      INTEGER(this->out)[this->i] = NA_INTEGER;
+      break;
+    case Adaptive_Type::dbl:
+      REAL(this->out)[this->i] = NA_REAL;
+      break;
+    case Adaptive_Type::str:
+      SET_STRING_ELT(this->out, this->i, NA_STRING);
+      break;
+    }
+    if (this->type != Adaptive_Type::str) {
+      this->tokens.emplace_back();
+    }
+    this->i++;
+  }
+
+  // the raw JSON token of a number may have trailing whitespace
+  static inline std::string_view trim_token(std::string_view token) {
+    while (!token.empty() && (token.back() == ' ' || token.back() == '\n' || token.back() == '\r' || token.back() == '\t')) {
+      token.remove_suffix(1);
+    }
+    return token;
+  }
+
+  inline void write_number(simdjson::ondemand::value json) {
+    // keep the number as written in the JSON
+    std::string_view token = json.raw_json_token();
+
+    this->grow_if_full();
+    if (this->type == Adaptive_Type::str) {
+      SET_STRING_ELT(this->out, this->i, mk_utf8_char(trim_token(token)));
+      this->i++;
+      return;
+    }
+
+    if (json.get_number_type() == simdjson::ondemand::number_type::signed_integer) {
+      int64_t x = int64_t(json);
+      if (this->type == Adaptive_Type::int_ && x > INT_MIN && x <= INT_MAX) {
+        INTEGER(this->out)[this->i] = static_cast<int>(x);
+      } else {
+        if (this->type == Adaptive_Type::int_) this->promote_to_double();
+        REAL(this->out)[this->i] = static_cast<double>(x);
+      }
+    } else {
+      double x = double(json);
+      if (this->type == Adaptive_Type::int_) this->promote_to_double();
+      REAL(this->out)[this->i] = x;
+    }
+    this->tokens.push_back(token);
+    this->i++;
+  }
+
+  inline void write_string(SEXP x) {
+    this->grow_if_full();
+    if (this->type != Adaptive_Type::str) {
+      this->promote_to_string();
+    }
+
+    SET_STRING_ELT(this->out, this->i, x);
+    this->i++;
+  }
+
+  // The default converted to the final type; a string default that is no
+  // number is `NA` in a numeric column and a default that is no whole number
+  // makes an integer column double.
+  inline void fill_defaults() {
+    if (this->default_rows.empty()) {
+      return;
+    }
+
+    if (this->type == Adaptive_Type::str) {
+      SEXP x = Rf_asChar(this->default_val);
+      for (int row : this->default_rows) {
+        SET_STRING_ELT(this->out, row, x);
+      }
+      return;
+    }
+
+    double x = NA_REAL;
+    switch (TYPEOF(this->default_val)) {
+    case REALSXP:
+      x = REAL(this->default_val)[0];
+      break;
+    case STRSXP: {
+      SEXP chr = STRING_ELT(this->default_val, 0);
+      if (chr != NA_STRING) {
+        char* end;
+        double parsed = std::strtod(CHAR(chr), &end);
+        if (end != CHAR(chr) && *end == '\0') x = parsed;
+      }
+      break;
+    }
+    default: {
+      int x_int = Rf_asInteger(this->default_val);
+      if (x_int != NA_INTEGER) x = x_int;
+    }
+    }
+
+    if (this->type == Adaptive_Type::int_ && !ISNAN(x) &&
+        (x != std::floor(x) || x <= INT_MIN || x > INT_MAX)) {
+      this->promote_to_double();
+    }
+    for (int row : this->default_rows) {
+      if (this->type == Adaptive_Type::int_) {
+        INTEGER(this->out)[row] = ISNAN(x) ? NA_INTEGER : static_cast<int>(x);
+      } else {
+        REAL(this->out)[row] = x;
+      }
+    }
+  }
+
+public:
+  // `default_val` is a length one integer, double or character vector
+  Column_Adaptive(SEXP default_val) {
+    this->default_val = default_val;
+  }
+
+  inline void reserve(int n) {
+    this->out = Rf_allocVector(INTSXP, n);
+    this->type = Adaptive_Type::int_;
+    this->i = 0;
+    this->n = n;
+    this->tokens.clear();
+    this->tokens.reserve(n);
+    this->default_rows.clear();
+  }
+
+  inline void add_value(simdjson::ondemand::value json, JSON_Path& path) {
+    switch (json.type()) {
+    case json_type::number:
+      this->write_number(json);
+      break;
+    case json_type::string:
+      this->write_string(parse_scalar_string(json, path));
+      break;
+    case json_type::null:
+      this->write_na();
+      break;
+    default:
+      bad_json_type(json, "int, double or string", path);
+      this->write_na();
+      break;
+    }
+
+    this->added_value = true;
+  }
+
+  inline void finalize_row() {
+    if (this->added_value) {
+      this->added_value = false;
+      return;
+    }
+
+    this->default_rows.push_back(this->i);
+    this->write_na();
+  }
+
+  inline void discard_row() {
+    if (this->added_value) {
+      this->i--;
+      if (this->type != Adaptive_Type::str) {
+        this->tokens.pop_back();
+      }
+      this->added_value = false;
+    }
+  }
+
+  inline int64_t buffer_bytes() {
+    return this->tokens.capacity() * sizeof(std::string_view) + this->default_rows.capacity() * sizeof(int);
+  }
+
+  inline SEXP get_value() {
+    this->fill_defaults();
+    SEXP out = shrink_vector(this->out, this->i);
+    this->out = R_NilValue;
+    return out;
+  }
+};
+
+
+// An array of `T` per row. The values of all rows are parsed into one shared
+// buffer and the list column is created from it in a single pass at the end.
+// Empty arrays become `NULL`.
 template <typename T>
 class Column_Vector : public virtual Column {
 protected:
-  SEXP default_val;
-  SEXP val;
-  int i = 0;
+  cpp11::sexp default_val;
+  // the default as values of `T`, for the export to Arrow
+  typename Native_Buffer<T>::type default_values;
+  typename Native_Buffer<T>::type values;
+  // the values of row `i` are `[offsets[i], offsets[i + 1])`
+  std::vector<int64_t> offsets;
+  // cleared for the rows that use the default
+  Validity_Bitmap has_value;
   bool added_value = false;
-  bool needs_unprotect = false;
 
 public:
   Column_Vector(SEXP default_val) {
     this->default_val = default_val;
+    append_r_values(this->default_values, default_val);
+  }
+
+  inline void reserve(int n) {
+    this->values.reset(0);
+    this->offsets.clear();
+    this->offsets.reserve(n + 1);
+    this->offsets.push_back(0);
+    this->has_value.reset(n);
+  }
+
+  inline void add_value(simdjson::ondemand::value json, JSON_Path& path) {
+    simdjson::ondemand::array array;
+    if (safe_get_array(json, path, array)) {
+      for (auto element : array) {
+        append_value<T>(this->values, element.value(), path);
+      }
+    }
+    this->added_value = true;
   }
 
-  ~Column_Vector() {
-    if (needs_unprotect) UNPROTECT(1);
+  inline void finalize_row() {
+    if (!this->added_value) {
+      this->values.append(this->default_values);
+    }
+    this->offsets.push_back(this->values.size());
+    this->has_value.push_back(this->added_value);
+    this->added_value = false;
+  }
+
+  inline void discard_row() {
+    while (this->values.size() > this->offsets.back()) {
+      this->values.pop_back();
+    }
+    this->added_value = false;
+  }
+
+  inline int64_t buffer_bytes() {
+    return this->values.capacity_bytes() + this->offsets.capacity() * sizeof(int64_t) +
+      this->has_value.capacity_bytes();
+  }
+
+  inline SEXP get_value() {
+    R_xlen_t n = this->has_value.size();
+    SEXP out = PROTECT(Rf_allocVector(VECSXP, n));
+
+    for (R_xlen_t i = 0; i < n; i++) {
+      if (!this->has_value.is_valid(i)) {
+        SET_VECTOR_ELT(out, i, this->default_val);
+      } else if (this->offsets[i + 1] > this->offsets[i]) {
+        SET_VECTOR_ELT(out, i, materialize_values<T>(this->values, this->offsets[i], this->offsets[i + 1]));
+      }
+    }
+
+    UNPROTECT(1);
+    return out;
+  }
+
+  // a row is missing if it is `NULL` in R, i.e. an empty array or a `NULL` default
+  inline void export_arrow(const std::string& name, bool dictionary, ArrowSchema* schema, ArrowArray* array) {
+    R_xlen_t n = this->has_value.size();
+    Validity_Bitmap validity;
+    validity.reset(n);
+    for (R_xlen_t i = 0; i < n; i++) {
+      if (this->has_value.is_valid(i)) {
+        validity.push_back(this->offsets[i + 1] > this->offsets[i]);
+      } else {
+        validity.push_back(!Rf_isNull(this->default_val));
+      }
+    }
+
+    export_arrow_list(std::move(this->offsets), validity, name, schema, array);
+    export_arrow_values<T>(this->values, "item", dictionary, schema->children[0], array->children[0]);
+  }
+};
+
+// A map (see `Parser_Map`) per row as a named vector. The keys and values of
+// all rows are parsed into two shared buffers and only split into the vectors
+// of the rows at the end.
+template <typename T>
+class Column_Map : public virtual Column {
+protected:
+  cpp11::sexp default_val;
+  String_Buffer keys;
+  typename Native_Buffer<T>::type values;
+  // the entries of row `i` are `[offsets[i], offsets[i + 1])`
+  std::vector<int64_t> offsets;
+  Validity_Bitmap validity;
+  bool added_value = false;
+
+public:
+  Column_Map(SEXP default_val) {
+    this->default_val = default_val;
   }
 
   inline void reserve(int n) {
-    this->val = PROTECT(Rf_allocVector(VECSXP, n));
-    this->i = 0;
-    this->needs_unprotect = true;
+    this->keys.reset(0);
+    this->values.reset(0);
+    this->offsets.clear();
+    this->offsets.reserve(n + 1);
+    this->offsets.push_back(0);
+    this->validity.reset(n);
   }
 
   inline void add_value(simdjson::ondemand::value json, JSON_Path& path) {
-    SEXP vec = parse_homo_array<T>(json, path);
-    int vec_size = Rf_length(vec);
-    if (vec_size == 0) {
-      SET_VECTOR_ELT(this->val, this->i, R_NilValue);
-    } else {
-      SET_VECTOR_ELT(this->val, this->i, vec);
+    simdjson::ondemand::object object;
+    if (json.type() == simdjson::ondemand::json_type::null || !safe_get_object(json, path, object)) {
+      return;
+    }
+
+    for (auto field : object) {
+      this->keys.push_back(safe_get_key(field));
+      append_value<T>(this->values, field.value(), path);
     }
-    this->i++;
     this->added_value = true;
   }
 
   inline void finalize_row() {
+    this->offsets.push_back(this->keys.size());
+    this->validity.push_back(this->added_value);
+    this->added_value = false;
+  }
+
+  inline void discard_row() {
+    while (this->keys.size() > this->offsets.back()) {
+      this->keys.pop_back();
+      this->values.pop_back();
+    }
+    this->added_value = false;
+  }
+
+  inline int64_t buffer_bytes() {
+    return this->keys.capacity_bytes() + this->values.capacity_bytes() +
+      this->offsets.capacity() * sizeof(int64_t) + this->validity.capacity_bytes();
+  }
+
+  inline SEXP get_value() {
+    R_xlen_t n = this->validity.size();
+    SEXP out = PROTECT(Rf_allocVector(VECSXP, n));
+
+    for (R_xlen_t i = 0; i < n; i++) {
+      if (!this->validity.is_valid(i)) {
+        SET_VECTOR_ELT(out, i, this->default_val);
+        continue;
+      }
+
+      SEXP x = PROTECT(materialize_values<T>(this->values, this->offsets[i], this->offsets[i + 1]));
+      Rf_setAttrib(x, R_NamesSymbol, materialize_character(this->keys, this->offsets[i], this->offsets[i + 1]));
+      SET_VECTOR_ELT(out, i, x);
+      UNPROTECT(1);
+    }
+
+    UNPROTECT(1);
+    return out;
+  }
+};
+
+// Rows that are arrays of `width` numbers stored as one `n x width` matrix
+// column. Without a declared width (-1) it is taken from the first row; missing
+// rows and rows of another length (which are reported) become `NA`.
+template <typename T>
+class Column_Matrix : public virtual Column {
+protected:
+  int declared_width;
+  R_xlen_t width = -1;
+  // column-major with `n` rows, all `NA` beyond `size`
+  std::vector<T> values;
+  R_xlen_t n = 0;
+  R_xlen_t size = 0;
+  bool added_value = false;
+
+  // `reserve()` is only a hint, e.g. for the rows of an unnested `df_vec`;
+  // doubles the number of rows and moves the columns to the new stride
+  inline void grow() {
+    R_xlen_t new_n = std::max<R_xlen_t>(2 * this->n, 1);
+    if (this->width > 0) {
+      std::vector<T> new_values(static_cast<size_t>(new_n) * this->width, na_value<T>());
+      for (R_xlen_t j = 0; j < this->width; j++) {
+        std::copy(this->values.begin() + j * this->n, this->values.begin() + (j + 1) * this->n,
+                  new_values.begin() + j * new_n);
+      }
+      this->values = std::move(new_values);
+    }
+    this->n = new_n;
+  }
+
+public:
+  Column_Matrix(int width) {
+    this->declared_width = width;
+  }
+
+  inline void reserve(int n) {
+    this->n = n;
+    this->size = 0;
+    this->width = this->declared_width;
+    this->values.clear();
+    if (this->width >= 0) {
+      this->values.assign(static_cast<size_t>(this->n) * this->width, na_value<T>());
+    }
+  }
+
+  inline void add_value(simdjson::ondemand::value json, JSON_Path& path) {
+    simdjson::ondemand::array array;
+    if (json.type() == simdjson::ondemand::json_type::null || !safe_get_array(json, path, array)) {
+      return;
+    }
+
+    if (this->size == this->n) {
+      this->grow();
+    }
+    R_xlen_t n_values = array.count_elements();
+    if (this->width < 0) {
+      this->width = n_values;
+      this->values.assign(static_cast<size_t>(this->n) * this->width, na_value<T>());
+    }
+    if (n_values != this->width) {
+      bad_array_length(json, this->width, n_values, path);
+      return;
+    }
+
+    parse_number_array<T>(array, this->n, this->values.data() + this->size, path);
+    this->added_value = true;
+  }
+
+  inline void finalize_row() {
+    if (this->size == this->n) {
+      this->grow();
+    }
+    this->size++;
+    this->added_value = false;
+  }
+
+  inline void discard_row() {
     if (this->added_value) {
+      for (R_xlen_t j = 0; j < this->width; j++) {
+        this->values[j * this->n + this->size] = na_value<T>();
+      }
       this->added_value = false;
-    }  else {
-      SET_VECTOR_ELT(this->val, this->i, this->default_val);
-      this->i++;
     }
   }
 
+  inline int64_t buffer_bytes() {
+    return this->values.capacity() * sizeof(T);
+  }
+
   inline SEXP get_value() {
-    UNPROTECT(1);
-    this->needs_unprotect = false;
-    return this->val;
+    return materialize_matrix(this->values, this->n, this->size, std::max<R_xlen_t>(this->width, 0));
   }
 };
 
@@ -258,6 +880,7 @@ protected:
   std::vector<std::unique_ptr<std::string>> string_view_protection;
   int size = 0;
   bool added_value = false;
+  Column_Stats* stats = nullptr;
 
 public:
   Column_Df(std::unordered_map<std::string, std::unique_ptr<Column>>& cols,
@@ -270,46 +893,63 @@ public:
     this->col_order = col_order;
   };
 
+  // `stats` counts the unknown keys
+  inline void set_stats(Column_Stats* stats) {
+    this->stats = stats;
+  }
+
   inline void reserve(int n) {
     for (auto& it : val) {
       (*it.second).reserve(n);
     }
+    this->size = 0;
   }
 
   inline void add_value(simdjson::ondemand::value json, JSON_Path& path) {
-    simdjson::ondemand::object object = safe_get_object(json, path);
+    simdjson::ondemand::object object;
+    if (!safe_get_object(json, path, object)) {
+      return;
+    }
 
-    path.insert_dummy<std::string_view>(); // insert dummy so that we can always replace the path
     for (auto field : object) {
       std::string_view key = safe_get_key(field);
 
       auto it = this->val.find(key);
       if (it != val.end()) {
-        path.replace(key);
         (*(*it).second).add_value(field.value(), path);
+      } else if (this->stats != nullptr) {
+        this->stats->n_unknown_keys++;
       }
-
     }
-    path.drop();
 
+    this->added_value = true;
+  }
+
+  // the fields are only finalized here so that `discard_row()` can still undo them
+  inline void finalize_row() {
     for (auto& col : this->val) {
       (*col.second).finalize_row();
     }
 
     this->size++;
-    this->added_value = true;
+    this->added_value = false;
   }
 
-  inline void finalize_row() {
+  inline void discard_row() {
     if (this->added_value) {
-      this->added_value = false;
-    }  else {
-      for (auto& it : val) {
-        (*this->val[it.first]).finalize_row();
+      for (auto& col : this->val) {
+        (*col.second).discard_row();
       }
+      this->added_value = false;
+    }
+  }
 
-      this->size++;
+  inline int64_t buffer_bytes() {
+    int64_t out = 0;
+    for (auto& col : this->val) {
+      out += (*col.second).buffer_bytes();
     }
+    return out;
   }
 
   inline SEXP get_value() {
@@ -322,35 +962,63 @@ public:
     UNPROTECT(1);
     return out;
   }
+
+  inline void export_arrow(const std::string& name, bool dictionary, ArrowSchema* schema, ArrowArray* array) {
+    export_arrow_struct(this->size, name, this->col_order.size(), schema, array);
+    for (size_t i = 0; i < this->col_order.size(); i++) {
+      const std::string& col_name = this->col_order[i];
+      (*this->val.find(col_name)->second).export_arrow(col_name, dictionary, schema->children[i], array->children[i]);
+    }
+  }
 };
 
+// The nested data frames of all rows are parsed into one shared set of
+// columns; the list column only refers to slices of them (see `nested_df.hpp`).
 class Column_ListOfDf : public virtual Column {
 protected:
-  SEXP val;
   Parser_Dataframe df_parser;
-  int current_row = 0;
+  Df_Class df_class;
+  // the nested rows of row `i` are `[starts[i], starts[i] + lengths[i])`;
+  // `lengths[i]` is `NA` for `NULL`
+  std::vector<int> starts;
+  std::vector<int> lengths;
+  int n_nested_rows = 0;
   bool added_value = false;
-  bool needs_unprotect = false;
 
 public:
   // TODO what exactly is this syntax?
   // https://stackoverflow.com/a/43306073
   Column_ListOfDf(std::unordered_map<std::string, std::unique_ptr<Column>>& list_element,
-                  std::vector<std::string> col_order) : df_parser(list_element, col_order) {
+                  std::vector<std::string> col_order,
+                  std::vector<std::pair<std::string, Row_Filter>> filters = {},
+                  Row_Sampler sampler = Row_Sampler(),
+                  Df_Class df_class = Df_Class::tibble) : df_parser(list_element, col_order, filters, sampler, Df_Class::data_frame) {
+    this->df_class = df_class;
   }
 
-  ~Column_ListOfDf() {
-    if (needs_unprotect) UNPROTECT(1);
+  // `stats` counts the unknown keys of the nested rows
+  inline void set_stats(Column_Stats* stats) {
+    this->df_parser.set_stats(stats);
   }
 
   inline void reserve(int n) {
-    this->val = PROTECT(Rf_allocVector(VECSXP, n));
-    this->current_row = 0;
+    this->df_parser.start_rows(n);
+    this->starts.clear();
+    this->starts.reserve(n);
+    this->lengths.clear();
+    this->lengths.reserve(n);
+    this->n_nested_rows = 0;
   }
 
   inline void add_value(simdjson::ondemand::value json, JSON_Path& path) {
-    SET_VECTOR_ELT(this->val, this->current_row, this->df_parser.parse_json(json, path));
-    this->current_row++;
+    int n = this->df_parser.append_rows(json, path);
+    this->starts.push_back(this->n_nested_rows);
+    if (n < 0) {
+      this->lengths.push_back(NA_INTEGER);
+    } else {
+      this->lengths.push_back(n);
+      this->n_nested_rows += n;
+    }
     this->added_value = true;
   }
 
@@ -358,14 +1026,230 @@ public:
     if (this->added_value) {
       this->added_value = false;
     } else {
-      SET_VECTOR_ELT(this->val, this->current_row, R_NilValue);
-      this->current_row++;
+      this->starts.push_back(this->n_nested_rows);
+      this->lengths.push_back(NA_INTEGER);
+    }
+  }
+
+  // the nested rows stay in the shared columns but are no longer referred to
+  inline void discard_row() {
+    if (this->added_value) {
+      this->starts.pop_back();
+      this->lengths.pop_back();
+      this->added_value = false;
     }
   }
 
+  inline int64_t buffer_bytes() {
+    return this->df_parser.buffer_bytes() + (this->starts.capacity() + this->lengths.capacity()) * sizeof(int);
+  }
+
   inline SEXP get_value() {
+    cpp11::sexp rows = this->df_parser.finish_rows();
+    return new_nested_dfs(rows, this->starts, this->lengths, this->df_class);
+  }
+
+  // A large list of structs whose child holds the shared columns. The nested
+  // rows of a discarded row stay in the shared columns, so if they lie between
+  // two rows this is a large list view instead, which has a size per row.
+  inline void export_arrow(const std::string& name, bool dictionary, ArrowSchema* schema, ArrowArray* array) {
+    size_t n = this->starts.size();
+    Validity_Bitmap validity;
+    validity.reset(n);
+    std::vector<int64_t> offsets;
+    offsets.reserve(n + 1);
+    std::vector<int64_t> sizes;
+    sizes.reserve(n);
+
+    bool has_gaps = false;
+    int64_t end = (n > 0) ? this->starts[0] : 0;
+    for (size_t i = 0; i < n; i++) {
+      bool is_null = this->lengths[i] == NA_INTEGER;
+      int64_t size = is_null ? 0 : this->lengths[i];
+      has_gaps = has_gaps || this->starts[i] != end;
+
+      validity.push_back(!is_null);
+      offsets.push_back(this->starts[i]);
+      sizes.push_back(size);
+      end = this->starts[i] + size;
+    }
+
+    if (has_gaps) {
+      export_arrow_list_view(std::move(offsets), std::move(sizes), validity, name, schema, array);
+    } else {
+      offsets.push_back(end);
+      export_arrow_list(std::move(offsets), validity, name, schema, array);
+    }
+    this->df_parser.export_arrow_rows("item", dictionary, schema->children[0], array->children[0]);
+  }
+};
+
+// A `df_vec` with `unnest = TRUE`: the rows of all nested arrays are parsed
+// into one set of columns instead of a data frame per row. Its data frame is
+// returned in long format (see `Parser_Dataframe::finish_unnested_rows()`).
+class Column_UnnestedDf : public virtual Column {
+protected:
+  Parser_Dataframe df_parser;
+  // the name of the column with the 1-based parent row; empty for none
+  std::string parent_row_name;
+  std::vector<int> parent_rows;
+  int current_row = 0;
+  // the number of nested rows of the current row
+  int n_added = 0;
+  bool has_discarded = false;
+
+public:
+  Column_UnnestedDf(std::unordered_map<std::string, std::unique_ptr<Column>>& list_element,
+                    std::vector<std::string> col_order,
+                    std::vector<std::pair<std::string, Row_Filter>> filters = {},
+                    std::string parent_row_name = "") : df_parser(list_element, col_order, filters) {
+    this->parent_row_name = parent_row_name;
+  }
+
+  // `stats` counts the unknown keys of the nested rows
+  inline void set_stats(Column_Stats* stats) {
+    this->df_parser.set_stats(stats);
+  }
+
+  inline void reserve(int n) {
+    this->df_parser.start_rows(n);
+    this->parent_rows.clear();
+    this->parent_rows.reserve(n);
+    this->current_row = 0;
+    this->n_added = 0;
+    this->has_discarded = false;
+  }
+
+  inline void add_value(simdjson::ondemand::value json, JSON_Path& path) {
+    int n = std::max(this->df_parser.append_rows(json, path), 0);
+    this->parent_rows.insert(this->parent_rows.end(), n, this->current_row);
+    this->n_added += n;
+  }
+
+  inline void finalize_row() {
+    this->current_row++;
+    this->n_added = 0;
+  }
+
+  // the nested rows are already finalized, so they are only marked and dropped
+  // in `get_value()`
+  inline void discard_row() {
+    if (this->n_added > 0) {
+      std::fill(this->parent_rows.end() - this->n_added, this->parent_rows.end(), -1);
+      this->has_discarded = true;
+      this->n_added = 0;
+    }
+  }
+
+  inline const std::vector<int>* get_parent_rows() {
+    return &this->parent_rows;
+  }
+
+  // the nested rows as a data frame; `get_parent_rows()` is only valid afterwards
+  inline SEXP get_value() {
+    cpp11::sexp nested = this->df_parser.finish_rows();
+
+    if (this->has_discarded) {
+      std::vector<int> keep;
+      std::vector<int> kept_parent_rows;
+      for (size_t i = 0; i < this->parent_rows.size(); i++) {
+        if (this->parent_rows[i] >= 0) {
+          keep.push_back(i);
+          kept_parent_rows.push_back(this->parent_rows[i]);
+        }
+      }
+      nested = slice_rows(nested, keep);
+      this->parent_rows = std::move(kept_parent_rows);
+    }
+
+    if (this->parent_row_name.empty()) {
+      return nested;
+    }
+
+    R_xlen_t n_cols = Rf_xlength(nested);
+    SEXP nested_names = Rf_getAttrib(nested, R_NamesSymbol);
+    std::vector<std::string> names = {this->parent_row_name};
+    for (R_xlen_t j = 0; j < n_cols; j++) {
+      names.push_back(Rf_translateCharUTF8(STRING_ELT(nested_names, j)));
+    }
+
+    SEXP out = PROTECT(new_df(names, this->parent_rows.size()));
+    SEXP parent_row = Rf_allocVector(INTSXP, this->parent_rows.size());
+    SET_VECTOR_ELT(out, 0, parent_row);
+    for (size_t i = 0; i < this->parent_rows.size(); i++) {
+      INTEGER(parent_row)[i] = this->parent_rows[i] + 1;
+    }
+    for (R_xlen_t j = 0; j < n_cols; j++) {
+      SET_VECTOR_ELT(out, j + 1, VECTOR_ELT(nested, j));
+    }
+
+    UNPROTECT(1);
+    return out;
+  }
+
+  inline int64_t buffer_bytes() {
+    return this->df_parser.buffer_bytes() + this->parent_rows.capacity() * sizeof(int);
+  }
+};
+
+// Wraps a column to record what it sees (spec option `stats = TRUE`)
+class Column_Instrumented : public virtual Column {
+protected:
+  std::unique_ptr<Column> column;
+  Column_Stats* stats;
+  bool added_value = false;
+
+public:
+  Column_Instrumented(std::unique_ptr<Column> column, Column_Stats* stats) {
+    this->column = std::move(column);
+    this->stats = stats;
+  }
+
+  inline void reserve(int n) {
+    (*this->column).reserve(n);
+  }
+
+  inline void add_value(simdjson::ondemand::value json, JSON_Path& path) {
+    count_value(this->stats, json);
+    uint64_t start = read_cycle_counter();
+    (*this->column).add_value(json, path);
+    this->stats->cycles += read_cycle_counter() - start;
+    this->added_value = true;
+  }
+
+  inline void finalize_row() {
+    if (!this->added_value) {
+      this->stats->n_defaults++;
+    }
+    this->added_value = false;
+    (*this->column).finalize_row();
+  }
+
+  inline void discard_row() {
+    this->added_value = false;
+    (*this->column).discard_row();
+  }
+
+  inline int64_t buffer_bytes() {
+    return (*this->column).buffer_bytes();
+  }
+
+  // the buffers only grow until they are converted, so this is their peak
+  inline SEXP get_value() {
+    this->stats->buffer_bytes = std::max(this->stats->buffer_bytes, (*this->column).buffer_bytes());
+    uint64_t start = read_cycle_counter();
+    SEXP out = PROTECT((*this->column).get_value());
+    this->stats->cycles += read_cycle_counter() - start;
+    count_r_memory(this->stats, out);
     UNPROTECT(1);
-    this->needs_unprotect = false;
-    return this->val;
+    return out;
+  }
+
+  inline const std::vector<int>* get_parent_rows() {
+    return (*this->column).get_parent_rows();
+  }
+
+  inline void export_arrow(const std::string& name, bool dictionary, ArrowSchema* schema, ArrowArray* array) {
+    (*this->column).export_arrow(name, dictionary, schema, array);
   }
 };
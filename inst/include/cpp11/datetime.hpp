@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// days since 1970-01-01 in the proleptic Gregorian calendar, see
+// http://howardhinnant.github.io/date_algorithms.html#days_from_civil
+inline int64_t days_from_civil(int64_t y, unsigned m, unsigned d) {
+  y -= m <= 2;
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = static_cast<unsigned>(y - era * 400);
+  const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+inline unsigned days_in_month(int64_t y, unsigned m) {
+  static const unsigned days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  if (m == 2 && (y % 4 == 0) && (y % 100 != 0 || y % 400 == 0)) {
+    return 29;
+  }
+
+  return days[m - 1];
+}
+
+// Parses exactly `n` digits. There is no early exit so that the loop over the
+// fixed layout can be unrolled and vectorized.
+inline bool parse_fixed_digits(const char* p, int n, int& out) {
+  int value = 0;
+  bool ok = true;
+  for (int i = 0; i < n; i++) {
+    unsigned digit = static_cast<unsigned char>(p[i]) - static_cast<unsigned>('0');
+    ok &= digit < 10;
+    value = value * 10 + static_cast<int>(digit);
+  }
+
+  out = value;
+  return ok;
+}
+
+// `YYYY-MM-DD` at the start of `x`
+inline bool parse_iso8601_date_part(std::string_view x, int64_t& days) {
+  if (x.size() < 10 || x[4] != '-' || x[7] != '-') {
+    return false;
+  }
+
+  int y, m, d;
+  bool ok = parse_fixed_digits(x.data(), 4, y) &
+    parse_fixed_digits(x.data() + 5, 2, m) &
+    parse_fixed_digits(x.data() + 8, 2, d);
+  if (!ok || m < 1 || m > 12 || d < 1 || static_cast<unsigned>(d) > days_in_month(y, m)) {
+    return false;
+  }
+
+  days = days_from_civil(y, m, d);
+  return true;
+}
+
+// `YYYY-MM-DD` to days since 1970-01-01
+inline bool parse_iso8601_date(std::string_view x, double& out) {
+  int64_t days;
+  if (x.size() != 10 || !parse_iso8601_date_part(x, days)) {
+    return false;
+  }
+
+  out = static_cast<double>(days);
+  return true;
+}
+
+// RFC 3339/ISO 8601 timestamp to seconds since 1970-01-01 UTC. Supports
+// * `YYYY-MM-DD` (midnight),
+// * `YYYY-MM-DDTHH:MM:SS` with `T`, `t` or a space as separator,
+// * optional fractional seconds (`.` or `,`, up to nanoseconds are used),
+// * an optional offset `Z`, `+HH`, `+HHMM` or `+HH:MM`. Without offset the time is in UTC.
+inline bool parse_iso8601_datetime(std::string_view x, double& out) {
+  int64_t days;
+  if (!parse_iso8601_date_part(x, days)) {
+    return false;
+  }
+  if (x.size() == 10) {
+    out = static_cast<double>(days * 86400);
+    return true;
+  }
+
+  // fast path for the fixed layout `YYYY-MM-DDTHH:MM:SS`
+  if (x.size() < 19 || (x[10] != 'T' && x[10] != ' ' && x[10] != 't') || x[13] != ':' || x[16] != ':') {
+    return false;
+  }
+  int hh, mm, ss;
+  bool ok = parse_fixed_digits(x.data() + 11, 2, hh) &
+    parse_fixed_digits(x.data() + 14, 2, mm) &
+    parse_fixed_digits(x.data() + 17, 2, ss);
+  // allow a leap second
+  if (!ok || hh > 23 || mm > 59 || ss > 60) {
+    return false;
+  }
+  int64_t seconds = days * 86400 + hh * 3600 + mm * 60 + ss;
+
+  size_t pos = 19;
+  double fraction = 0;
+  if (pos < x.size() && (x[pos] == '.' || x[pos] == ',')) {
+    pos++;
+    size_t start = pos;
+    int64_t digits = 0;
+    int64_t scale = 1;
+    while (pos < x.size() && static_cast<unsigned char>(x[pos] - '0') < 10) {
+      if (pos - start < 9) {
+        digits = digits * 10 + (x[pos] - '0');
+        scale *= 10;
+      }
+      pos++;
+    }
+    if (pos == start) {
+      return false;
+    }
+    fraction = static_cast<double>(digits) / static_cast<double>(scale);
+  }
+
+  if (pos < x.size()) {
+    char c = x[pos];
+    if (c == 'Z' || c == 'z') {
+      pos++;
+    } else if (c == '+' || c == '-') {
+      pos++;
+      int oh, om = 0;
+      if (x.size() - pos < 2 || !parse_fixed_digits(x.data() + pos, 2, oh)) {
+        return false;
+      }
+      pos += 2;
+      if (pos < x.size()) {
+        if (x[pos] == ':') pos++;
+        if (x.size() - pos < 2 || !parse_fixed_digits(x.data() + pos, 2, om)) {
+          return false;
+        }
+        pos += 2;
+      }
+      if (oh > 23 || om > 59) {
+        return false;
+      }
+
+      int64_t offset = oh * 3600 + om * 60;
+      seconds -= (c == '-') ? -offset : offset;
+    } else {
+      return false;
+    }
+  }
+
+  if (pos != x.size()) {
+    return false;
+  }
+
+  out = static_cast<double>(seconds) + fraction;
+  return true;
+}
@@ -0,0 +1,286 @@
+#pragma once
+
+#define STRICT_R_HEADERS
+#include "cpp11.hpp"
+#include "json_utils.hpp"
+
+#include <climits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+enum class Inferred_Kind {none, scalar, vec, df, df_vec, mixed};
+enum class Inferred_Scalar {none, lgl, int_, dbl, str, auto_, mixed};
+
+inline Inferred_Scalar unify_scalar_type(Inferred_Scalar x, Inferred_Scalar y) {
+  if (x == y || y == Inferred_Scalar::none) {
+    return x;
+  }
+  if (x == Inferred_Scalar::none) {
+    return y;
+  }
+
+  // integers are promoted to doubles
+  if ((x == Inferred_Scalar::int_ && y == Inferred_Scalar::dbl) ||
+      (x == Inferred_Scalar::dbl && y == Inferred_Scalar::int_)) {
+    return Inferred_Scalar::dbl;
+  }
+
+  // numbers and strings can still be parsed by an adaptive column
+  if (x != Inferred_Scalar::lgl && y != Inferred_Scalar::lgl && x != Inferred_Scalar::mixed && y != Inferred_Scalar::mixed) {
+    return Inferred_Scalar::auto_;
+  }
+
+  return Inferred_Scalar::mixed;
+}
+
+inline Inferred_Scalar scalar_type_of(simdjson::ondemand::value element) {
+  using simdjson::ondemand::json_type;
+  switch (element.type()) {
+  case json_type::boolean:
+    return Inferred_Scalar::lgl;
+    break;
+  case json_type::number:
+    if (element.get_number_type() == simdjson::ondemand::number_type::signed_integer) {
+      int64_t x = int64_t(element);
+      // INT_MIN is `NA_integer_` in R
+      if (x > INT_MIN && x <= INT_MAX) {
+        return Inferred_Scalar::int_;
+      }
+    }
+    return Inferred_Scalar::dbl;
+    break;
+  case json_type::string:
+    return Inferred_Scalar::str;
+    break;
+  default:
+    return Inferred_Scalar::none;
+  }
+}
+
+// Collects the types of all values seen at one path and unifies them to the
+// type of a spec element as used by `parse_sub_spec()`.
+class Type_Collector {
+protected:
+  Inferred_Kind kind = Inferred_Kind::none;
+  Inferred_Scalar scalar_type = Inferred_Scalar::none;
+  bool null_elements = false;
+  int n_values = 0;
+  int n_null = 0;
+  int n_objects = 0;
+
+  std::unordered_map<std::string_view, std::unique_ptr<Type_Collector>> fields;
+  // also keeps the order in which the fields were first seen
+  std::vector<std::unique_ptr<std::string>> string_view_protection;
+
+  inline void update_kind(Inferred_Kind new_kind) {
+    if (this->kind == new_kind || this->kind == Inferred_Kind::mixed) {
+      return;
+    }
+
+    if (this->kind == Inferred_Kind::none) {
+      this->kind = new_kind;
+    } else if (this->kind == Inferred_Kind::vec &&
+               new_kind == Inferred_Kind::df_vec &&
+               this->scalar_type == Inferred_Scalar::none &&
+               !this->null_elements) {
+      // so far only empty arrays were seen
+      this->kind = Inferred_Kind::df_vec;
+    } else {
+      this->kind = Inferred_Kind::mixed;
+    }
+  }
+
+  inline void add_fields(simdjson::ondemand::object object) {
+    this->n_objects++;
+
+    for (auto field : object) {
+      std::string_view key = safe_get_key(field);
+
+      auto it = this->fields.find(key);
+      if (it == this->fields.end()) {
+        this->string_view_protection.push_back(std::make_unique<std::string>(key));
+        it = this->fields.insert({*this->string_view_protection.back(), std::make_unique<Type_Collector>()}).first;
+      }
+
+      (*(*it).second).add_value(field.value());
+    }
+  }
+
+public:
+  inline void add_value(simdjson::ondemand::value json) {
+    using simdjson::ondemand::json_type;
+    this->n_values++;
+
+    switch (json.type()) {
+    case json_type::null:
+      this->n_null++;
+      break;
+    case json_type::object:
+      this->update_kind(Inferred_Kind::df);
+      if (this->kind == Inferred_Kind::df) {
+        this->add_fields(json.get_object());
+      }
+      break;
+    case json_type::array: {
+      bool empty = true;
+      for (auto element : json.get_array()) {
+        empty = false;
+        this->add_element(element.value());
+      }
+      if (empty && this->kind == Inferred_Kind::none) {
+        this->kind = Inferred_Kind::vec;
+      }
+      break;
+    }
+    default:
+      this->update_kind(Inferred_Kind::scalar);
+      this->scalar_type = unify_scalar_type(this->scalar_type, scalar_type_of(json));
+    }
+  }
+
+  // add an element of an array, e.g. a record of the input
+  inline void add_element(simdjson::ondemand::value element) {
+    using simdjson::ondemand::json_type;
+
+    switch (element.type()) {
+    case json_type::null:
+      this->null_elements = true;
+      this->update_kind(Inferred_Kind::vec);
+      break;
+    case json_type::object:
+      this->update_kind(Inferred_Kind::df_vec);
+      if (this->kind == Inferred_Kind::df_vec) {
+        this->add_fields(element.get_object());
+      }
+      break;
+    case json_type::array:
+      this->kind = Inferred_Kind::mixed;
+      break;
+    default:
+      this->update_kind(Inferred_Kind::vec);
+      this->scalar_type = unify_scalar_type(this->scalar_type, scalar_type_of(element));
+    }
+  }
+
+  inline std::string type_name() const {
+    std::string scalar;
+    switch (this->scalar_type) {
+    case Inferred_Scalar::none:
+      // only `null` was seen
+      scalar = "lgl";
+      break;
+    case Inferred_Scalar::lgl:
+      scalar = "lgl";
+      break;
+    case Inferred_Scalar::int_:
+      scalar = "int";
+      break;
+    case Inferred_Scalar::dbl:
+      scalar = "dbl";
+      break;
+    case Inferred_Scalar::str:
+      scalar = "str";
+      break;
+    case Inferred_Scalar::auto_:
+      scalar = "auto";
+      break;
+    case Inferred_Scalar::mixed:
+      return "mixed";
+      break;
+    }
+
+    switch (this->kind) {
+    case Inferred_Kind::none:
+    case Inferred_Kind::scalar:
+      return scalar;
+      break;
+    case Inferred_Kind::vec:
+      if (this->scalar_type == Inferred_Scalar::auto_) {
+        return "mixed";
+      }
+      return scalar + "_vec";
+      break;
+    case Inferred_Kind::df:
+      return "df";
+      break;
+    case Inferred_Kind::df_vec:
+      return "df_vec";
+      break;
+    case Inferred_Kind::mixed:
+      return "mixed";
+      break;
+    }
+
+    return "mixed";
+  }
+
+  inline bool has_field(const std::string& name) const {
+    return this->fields.find(name) != this->fields.end();
+  }
+
+  inline const Type_Collector& field(const std::string& name) const {
+    auto it = this->fields.find(name);
+    if (it == this->fields.end()) {
+      cpp11::stop("Type_Collector::field(): no field `%s`", name.c_str());
+    }
+
+    return *(*it).second;
+  }
+
+  // `n_parent` is the number of objects the field could have occurred in
+  inline bool is_nullable(int n_parent) const {
+    return this->n_null > 0 || this->n_values < n_parent;
+  }
+
+  inline SEXP default_value() const {
+    if (this->kind != Inferred_Kind::none && this->kind != Inferred_Kind::scalar) {
+      return R_NilValue;
+    }
+
+    switch (this->scalar_type) {
+    case Inferred_Scalar::int_:
+      return Rf_ScalarInteger(NA_INTEGER);
+      break;
+    case Inferred_Scalar::dbl:
+      return Rf_ScalarReal(NA_REAL);
+      break;
+    case Inferred_Scalar::str:
+      return Rf_ScalarString(NA_STRING);
+      break;
+    default:
+      return Rf_ScalarLogical(NA_LOGICAL);
+    }
+  }
+
+  // spec of the fields of the objects seen so far, in the order they were first seen
+  inline cpp11::list fields_spec(const std::string& parent_path) const {
+    using namespace cpp11::literals;
+    cpp11::writable::list out;
+
+    for (auto& name : this->string_view_protection) {
+      const Type_Collector& child = *this->fields.at(*name);
+      std::string type = child.type_name();
+
+      if (type == "mixed") {
+        cpp11::warning("Field at path %s/%s has incompatible types and is not part of the spec.",
+                       parent_path.c_str(), name->c_str());
+        continue;
+      }
+
+      cpp11::writable::list element({
+        "path"_nm = cpp11::as_sexp(*name),
+        "type"_nm = cpp11::as_sexp(type),
+        "default"_nm = child.default_value(),
+        "nullable"_nm = cpp11::as_sexp(child.is_nullable(this->n_objects))
+      });
+      if (type == "df" || type == "df_vec") {
+        element.push_back("fields"_nm = child.fields_spec(parent_path + "/" + *name));
+      }
+
+      out.push_back(element);
+    }
+
+    return out;
+  }
+};
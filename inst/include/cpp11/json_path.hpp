@@ -1,10 +1,16 @@
 #pragma once
 
+#include <deque>
 #include <vector>
 #include <string>
+#include <string_view>
+
+#include "unescape.hpp"
 
 enum PathType {str, ind};
 
+class Problems;
+
 class JSON_Path_Element {
 private:
   int index;
@@ -32,6 +38,14 @@ public:
     // this->type = PathType::str;
   }
 
+  bool is_index() const {
+    return this->type == PathType::ind;
+  }
+
+  int get_index() const {
+    return this->index;
+  }
+
   std::string to_path() const {
     switch (this->type) {
     case PathType::ind:
@@ -41,13 +55,37 @@ public:
       return "/" + std::string(this->key);
       break;
     }
+
+    return "";
   }
 };
 
+// The path is not tracked while parsing. Only elements outside of the current
+// document (e.g. the line of newline delimited JSON) are inserted explicitly;
+// the path inside the document is reconstructed from the position of the
+// offending value by `path_to()` once an error is raised.
 class JSON_Path {
 private:
   std::vector<JSON_Path_Element> path_elements;
-  int level = 0;
+  std::string_view document;
+  Problems* problems = nullptr;
+
+  // The state of the last scan of `path_to()`. Problems are found in document
+  // order, so the next scan usually resumes here instead of at the start.
+  mutable std::vector<JSON_Path_Element> scan_stack;
+  // the unescaped key of each level of `scan_stack` that needed unescaping; a
+  // deque so that the keys stay in place while levels are added
+  mutable std::deque<std::string> scan_keys;
+  mutable const char* scan_position = nullptr;
+  mutable bool scan_expect_key = false;
+
+  void reset_scan() const {
+    this->scan_stack.clear();
+    this->scan_keys.clear();
+    this->scan_position = this->document.data();
+    this->scan_expect_key = false;
+  }
+
 public:
   void insert(int index) {
     path_elements.push_back(JSON_Path_Element(index));
@@ -60,16 +98,6 @@ public:
   template <typename T>
   void insert_dummy();
 
-  template<>
-  void insert_dummy<int>() {
-    this->insert(-1);
-  }
-
-  template<>
-  void insert_dummy<std::string_view>() {
-    this->insert(std::string_view(""));
-  }
-
   void replace(int index) {
     path_elements.back().update(index);
   }
@@ -82,6 +110,21 @@ public:
     path_elements.pop_back();
   }
 
+  // the JSON text the positions passed to `path_to()` point into
+  void set_document(std::string_view document) {
+    this->document = document;
+    this->reset_scan();
+  }
+
+  // where values that cannot be parsed are reported instead of raising an error
+  void set_problems(Problems* problems) {
+    this->problems = problems;
+  }
+
+  Problems* get_problems() const {
+    return this->problems;
+  }
+
   std::string path() const {
     std::string out = "";
     for (auto & it : path_elements) {
@@ -90,4 +133,101 @@ public:
 
     return out;
   }
+
+  // `true` if `location` is the start of the top-level value of the document
+  bool is_document_root(const char* location) const {
+    const char* p = this->document.data();
+    const char* end = p + this->document.size();
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+      p++;
+    }
+    return p != nullptr && p == location;
+  }
+
+  // Path of the value starting at `location`. The document is scanned up to
+  // `location` keeping track of the open containers and their current key or
+  // index, so this is only meant for error messages and problems. The scan
+  // continues from the previous call unless `location` lies before it.
+  std::string path_to(const char* location) const {
+    std::string out = this->path();
+
+    const char* begin = this->document.data();
+    if (begin == nullptr || location < begin || location > begin + this->document.size()) {
+      return out;
+    }
+
+    if (this->scan_position == nullptr || location < this->scan_position) {
+      this->reset_scan();
+    }
+
+    std::vector<JSON_Path_Element>& stack = this->scan_stack;
+    bool& expect_key = this->scan_expect_key;
+    const char* p = this->scan_position;
+    bool in_string = false;
+    for (; p < location; p++) {
+      switch (*p) {
+      case '{':
+        stack.push_back(JSON_Path_Element(std::string_view("")));
+        this->scan_keys.emplace_back();
+        expect_key = true;
+        break;
+      case '[':
+        stack.push_back(JSON_Path_Element(0));
+        this->scan_keys.emplace_back();
+        break;
+      case '}':
+      case ']':
+        if (!stack.empty()) {
+          stack.pop_back();
+          this->scan_keys.pop_back();
+        }
+        break;
+      case ',':
+        if (!stack.empty() && stack.back().is_index()) {
+          stack.back().update(stack.back().get_index() + 1);
+        } else {
+          expect_key = true;
+        }
+        break;
+      case '"': {
+        const char* start = p + 1;
+        for (p = start; p < location && *p != '"'; p++) {
+          if (*p == '\\') p++;
+        }
+        in_string = p >= location;
+        if (expect_key && !stack.empty()) {
+          std::string_view key(start, p - start);
+          std::string& unescaped = this->scan_keys.back();
+          unescaped.clear();
+          if (key.find('\\') != std::string_view::npos && append_unescaped(key, unescaped)) {
+            key = unescaped;
+          }
+          stack.back().update(key);
+          expect_key = false;
+        }
+        break;
+      }
+      default:
+        break;
+      }
+    }
+    // A scan that stopped inside a string cannot be resumed.
+    this->scan_position = in_string ? nullptr : p;
+
+    for (auto & it : stack) {
+      out += it.to_path();
+    }
+
+    return out;
+  }
 };
+
+template <>
+inline void JSON_Path::insert_dummy<int>() {
+  this->insert(-1);
+}
+
+template <>
+inline void JSON_Path::insert_dummy<std::string_view>() {
+  this->insert(std::string_view(""));
+}
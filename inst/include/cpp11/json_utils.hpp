@@ -5,6 +5,8 @@
 
 #include "cpp11/simdjson.h"
 #include "json_path.hpp"
+#include "problems.hpp"
+#include "unescape.hpp"
 
 inline std::string json_type_to_string(simdjson::ondemand::value element) {
   using simdjson::ondemand::json_type;
@@ -30,24 +32,49 @@ inline std::string json_type_to_string(simdjson::ondemand::value element) {
   }
 }
 
-inline simdjson::ondemand::array safe_get_array(simdjson::ondemand::value json, JSON_Path& path) {
-  simdjson::ondemand::array array;
+// only call this for error messages, see `JSON_Path::path_to()`
+inline std::string path_of(simdjson::ondemand::value element, const JSON_Path& path) {
+  return path.path_to(element.raw_json_token().data());
+}
+
+// Reports a value that cannot be parsed. Unless `path` collects problems this
+// calls `raise()`, which must throw; otherwise the problem is recorded and the
+// caller continues with a missing value.
+template <typename F>
+inline void raise_problem(simdjson::ondemand::value element, const std::string& expected,
+                          const std::string& actual, const JSON_Path& path, F raise) {
+  Problems* problems = path.get_problems();
+  if (problems == nullptr || problems->get_mode() == Error_Mode::stop) {
+    raise();
+  }
+
+  problems->add(path_of(element, path), expected, actual);
+}
+
+// `false` if `json` is not an array and the problem was recorded instead
+inline bool safe_get_array(simdjson::ondemand::value json, JSON_Path& path, simdjson::ondemand::array& array) {
   auto error = json.get_array().get(array);
   if (error) {
-    cpp11::stop("Element at path " + path.path() + " is not an array.");
+    raise_problem(json, "array", json_type_to_string(json), path, [&]() {
+      cpp11::stop("Element at path " + path_of(json, path) + " is not an array.");
+    });
+    return false;
   }
 
-  return array;
+  return true;
 }
 
-inline simdjson::ondemand::object safe_get_object(simdjson::ondemand::value json, JSON_Path& path) {
-  simdjson::ondemand::object object;
+// `false` if `json` is not an object and the problem was recorded instead
+inline bool safe_get_object(simdjson::ondemand::value json, JSON_Path& path, simdjson::ondemand::object& object) {
   auto error = json.get_object().get(object);
   if (error) {
-    cpp11::stop("Element at path " + path.path() + " is not an object.");
+    raise_problem(json, "object", json_type_to_string(json), path, [&]() {
+      cpp11::stop("Element at path " + path_of(json, path) + " is not an object.");
+    });
+    return false;
   }
 
-  return object;
+  return true;
 }
 
 inline std::string_view safe_get_key(simdjson::simdjson_result<simdjson::ondemand::field> field) {
@@ -60,3 +87,27 @@ inline std::string_view safe_get_key(simdjson::simdjson_result<simdjson::ondeman
 
   return key_v;
 }
+
+// The content of a JSON string as written in the input, i.e. still escaped
+inline std::string_view raw_string_content(simdjson::ondemand::value element) {
+  std::string_view token = element.raw_json_token();
+  return token.substr(1, token.find_last_of('"') - 1);
+}
+
+// The content of a JSON string. Strings without escape sequences are taken
+// directly from the input instead of being unescaped into the string buffer.
+inline std::string_view string_content(simdjson::ondemand::value element) {
+  std::string_view raw = raw_string_content(element);
+  if (raw.find('\\') == std::string_view::npos) {
+    return raw;
+  }
+
+  return std::string_view(element);
+}
+
+// The first element of `json` as input for simdjson, translated to UTF-8. A
+// UTF-8 or ASCII string is copied as is, without translation.
+inline simdjson::padded_string padded_json(cpp11::strings json) {
+  SEXP x = STRING_ELT(json, 0);
+  return simdjson::padded_string(std::string_view(Rf_translateCharUTF8(x)));
+}
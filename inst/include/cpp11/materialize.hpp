@@ -0,0 +1,167 @@
+#pragma once
+
+#define STRICT_R_HEADERS
+#include "cpp11.hpp"
+#include "cpp11/R.hpp"
+#include "column_buffer.hpp"
+#include "utils.hpp"
+
+#include <climits>
+#include <cstring>
+#include <type_traits>
+
+// The single pass from native column buffers to R vectors. Fixed width values
+// already use R's missing value sentinels and are copied as a block.
+
+inline SEXP materialize_logical(const Column_Buffer<int32_t>& x, int64_t begin, int64_t end) {
+  SEXP out = Rf_allocVector(LGLSXP, end - begin);
+  if (end > begin) {
+    std::memcpy(LOGICAL(out), x.data() + begin, (end - begin) * sizeof(int32_t));
+  }
+  return out;
+}
+
+inline SEXP materialize_logical(const Column_Buffer<int32_t>& x) {
+  return materialize_logical(x, 0, x.size());
+}
+
+inline SEXP materialize_integer(const Column_Buffer<int32_t>& x, int64_t begin, int64_t end) {
+  SEXP out = Rf_allocVector(INTSXP, end - begin);
+  if (end > begin) {
+    std::memcpy(INTEGER(out), x.data() + begin, (end - begin) * sizeof(int32_t));
+  }
+  return out;
+}
+
+inline SEXP materialize_integer(const Column_Buffer<int32_t>& x) {
+  return materialize_integer(x, 0, x.size());
+}
+
+inline SEXP materialize_double(const Column_Buffer<double>& x, int64_t begin, int64_t end) {
+  SEXP out = Rf_allocVector(REALSXP, end - begin);
+  if (end > begin) {
+    std::memcpy(REAL(out), x.data() + begin, (end - begin) * sizeof(double));
+  }
+  return out;
+}
+
+inline SEXP materialize_double(const Column_Buffer<double>& x) {
+  return materialize_double(x, 0, x.size());
+}
+
+// the bits of the int64 values in a double vector, as bit64 stores them
+inline SEXP materialize_integer64(const Column_Buffer<int64_t>& x) {
+  SEXP out = Rf_allocVector(REALSXP, x.size());
+  if (x.size() > 0) {
+    std::memcpy(REAL(out), x.data(), x.size() * sizeof(int64_t));
+  }
+  return out;
+}
+
+inline SEXP materialize_character(const String_Buffer& x, int64_t begin, int64_t end) {
+  SEXP out = PROTECT(Rf_allocVector(STRSXP, end - begin));
+  const Validity_Bitmap& validity = x.get_validity();
+
+  for (int64_t i = begin; i < end; i++) {
+    if (!validity.is_valid(i)) {
+      SET_STRING_ELT(out, i - begin, NA_STRING);
+      continue;
+    }
+    SET_STRING_ELT(out, i - begin, mk_utf8_char(x.get(i)));
+  }
+
+  UNPROTECT(1);
+  return out;
+}
+
+inline SEXP materialize_character(const String_Buffer& x) {
+  return materialize_character(x, 0, x.size());
+}
+
+// The values `[begin, end)` of the buffer for values of type `T`, e.g. the
+// values of one row of a nested column.
+template <typename T>
+inline SEXP materialize_values(const typename Native_Buffer<T>::type& x, int64_t begin, int64_t end);
+
+template <>
+inline SEXP materialize_values<bool>(const Column_Buffer<int32_t>& x, int64_t begin, int64_t end) {
+  return materialize_logical(x, begin, end);
+}
+
+template <>
+inline SEXP materialize_values<int>(const Column_Buffer<int32_t>& x, int64_t begin, int64_t end) {
+  return materialize_integer(x, begin, end);
+}
+
+template <>
+inline SEXP materialize_values<double>(const Column_Buffer<double>& x, int64_t begin, int64_t end) {
+  return materialize_double(x, begin, end);
+}
+
+template <>
+inline SEXP materialize_values<std::string>(const String_Buffer& x, int64_t begin, int64_t end) {
+  return materialize_character(x, begin, end);
+}
+
+// `values` holds a column-major matrix with `stride` rows of which the first
+// `n_rows` are used. R stores the dimensions as int, but the matrix itself may
+// be a long vector.
+template <typename T>
+inline SEXP materialize_matrix(const std::vector<T>& values, R_xlen_t stride, R_xlen_t n_rows, R_xlen_t width) {
+  static_assert(std::is_same<T, int>::value || std::is_same<T, double>::value, "only int and double matrices");
+  if (n_rows > INT_MAX || width > INT_MAX) {
+    cpp11::stop("A matrix can have at most %d rows and columns.", INT_MAX);
+  }
+  SEXP out = Rf_allocMatrix(std::is_same<T, int>::value ? INTSXP : REALSXP, static_cast<int>(n_rows), static_cast<int>(width));
+
+  T* out_data;
+  if constexpr (std::is_same<T, int>::value) {
+    out_data = INTEGER(out);
+  } else {
+    out_data = REAL(out);
+  }
+  for (R_xlen_t j = 0; j < width && n_rows > 0; j++) {
+    std::memcpy(out_data + j * n_rows, values.data() + j * stride, n_rows * sizeof(T));
+  }
+
+  return out;
+}
+
+// The reverse direction for values that are still held in R vectors, e.g. to
+// export them to Arrow. `values` is coerced to the type of the buffer.
+inline void append_r_values(Column_Buffer<int32_t>& x, SEXP values) {
+  if (Rf_isNull(values)) return;
+
+  SEXP coerced = PROTECT(TYPEOF(values) == LGLSXP ? values : Rf_coerceVector(values, INTSXP));
+  const int* data = TYPEOF(coerced) == LGLSXP ? LOGICAL(coerced) : INTEGER(coerced);
+  for (R_xlen_t i = 0; i < Rf_xlength(coerced); i++) {
+    x.push_back(data[i]);
+  }
+  UNPROTECT(1);
+}
+
+inline void append_r_values(Column_Buffer<double>& x, SEXP values) {
+  if (Rf_isNull(values)) return;
+
+  SEXP coerced = PROTECT(Rf_coerceVector(values, REALSXP));
+  const double* data = REAL(coerced);
+  for (R_xlen_t i = 0; i < Rf_xlength(coerced); i++) {
+    x.push_back(data[i]);
+  }
+  UNPROTECT(1);
+}
+
+inline void append_r_values(String_Buffer& x, SEXP values) {
+  if (Rf_isNull(values)) return;
+
+  SEXP coerced = PROTECT(Rf_coerceVector(values, STRSXP));
+  for (R_xlen_t i = 0; i < Rf_xlength(coerced); i++) {
+    SEXP value = STRING_ELT(coerced, i);
+    if (value == NA_STRING) {
+      x.push_null();
+    } else {
+      x.push_back(Rf_translateCharUTF8(value));
+    }
+  }
+  UNPROTECT(1);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "cpp11/simdjson.h"
+
+#include <cstring>
+#include <string_view>
+
+// Walks the lines of a newline delimited JSON buffer. The lines are not copied:
+// every line points into `content` whose padding also pads the line, so it can
+// be handed to `parser.iterate()` directly.
+class Ndjson_Reader {
+private:
+  const simdjson::padded_string& content;
+  size_t pos = 0;
+  size_t line_start = 0;
+
+public:
+  Ndjson_Reader(const simdjson::padded_string& content) : content(content) {}
+
+  // returns false when there are no more lines; blank lines are skipped
+  inline bool next_line(std::string_view& line) {
+    const char* data = this->content.data();
+    const size_t size = this->content.size();
+
+    while (this->pos < size) {
+      const char* start = data + this->pos;
+      const char* newline = static_cast<const char*>(std::memchr(start, '\n', size - this->pos));
+      size_t len = (newline == nullptr) ? size - this->pos : newline - start;
+
+      this->line_start = this->pos;
+      this->pos += len + 1;
+
+      // drop `\r` of Windows line endings and skip whitespace only lines
+      size_t end = len;
+      while (end > 0 && (start[end - 1] == '\r' || start[end - 1] == ' ' || start[end - 1] == '\t')) {
+        end--;
+      }
+      if (end == 0) {
+        continue;
+      }
+
+      line = std::string_view(start, end);
+      return true;
+    }
+
+    return false;
+  }
+
+  // capacity of the buffer behind the current line, as needed by `parser.iterate()`
+  inline size_t capacity() const {
+    return this->content.size() - this->line_start + simdjson::SIMDJSON_PADDING;
+  }
+};
+
+// number of non-blank lines
+inline int count_ndjson_lines(const simdjson::padded_string& content) {
+  auto reader = Ndjson_Reader(content);
+  std::string_view line;
+  int n = 0;
+  while (reader.next_line(line)) {
+    n++;
+  }
+
+  return n;
+}
+
+// `true` if the first non-whitespace character of `content` opens an array,
+// i.e. the input is a single JSON array rather than newline delimited JSON.
+inline bool is_json_array(const simdjson::padded_string& content) {
+  for (size_t i = 0; i < content.size(); i++) {
+    char c = content.data()[i];
+    if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+      continue;
+    }
+    return c == '[';
+  }
+
+  return false;
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#define STRICT_R_HEADERS
+#include "cpp11.hpp"
+#include "cpp11/R.hpp"
+#include "utils.hpp"
+
+#include <R_ext/Altrep.h>
+#include <Rversion.h>
+
+#include <numeric>
+#include <vector>
+
+// A list column of data frames that all share the rows of one data frame
+// `rows`: element `i` holds the rows `[starts[i], starts[i] + lengths[i])`
+// and is `NULL` if `lengths[i]` is `NA`. With R >= 4.3 the column is an
+// ALTREP list that only creates an element when it is accessed.
+
+// the data frame of element `i`; `info` is `list(rows, starts, lengths, df_class)`
+inline SEXP nested_df_element(SEXP info, R_xlen_t i) {
+  int length = INTEGER(VECTOR_ELT(info, 2))[i];
+  if (length == NA_INTEGER) {
+    return R_NilValue;
+  }
+
+  SEXP rows = VECTOR_ELT(info, 0);
+  std::vector<int> index(length);
+  std::iota(index.begin(), index.end(), INTEGER(VECTOR_ELT(info, 1))[i]);
+
+  SEXP nms = Rf_getAttrib(rows, R_NamesSymbol);
+  std::vector<std::string> col_nms;
+  for (R_xlen_t j = 0; j < Rf_xlength(rows); j++) {
+    col_nms.push_back(Rf_translateCharUTF8(STRING_ELT(nms, j)));
+  }
+
+  Df_Class df_class = static_cast<Df_Class>(INTEGER(VECTOR_ELT(info, 3))[0]);
+  SEXP out = PROTECT(new_df(col_nms, length, df_class));
+  for (R_xlen_t j = 0; j < Rf_xlength(rows); j++) {
+    SET_VECTOR_ELT(out, j, slice_rows(VECTOR_ELT(rows, j), index));
+  }
+
+  UNPROTECT(1);
+  return out;
+}
+
+inline SEXP materialize_nested_dfs(SEXP info) {
+  R_xlen_t n = Rf_xlength(VECTOR_ELT(info, 2));
+  SEXP out = PROTECT(Rf_allocVector(VECSXP, n));
+  for (R_xlen_t i = 0; i < n; i++) {
+    SET_VECTOR_ELT(out, i, nested_df_element(info, i));
+  }
+
+  UNPROTECT(1);
+  return out;
+}
+
+// set by `register_nested_df_class()` when the package is loaded
+inline R_altrep_class_t nested_df_class;
+
+#if R_VERSION >= R_Version(4, 3, 0)
+
+// `data1` is the `info` list until the column is materialized and `NULL`
+// afterwards; `data2` is `NULL` or the list of the elements created so far. Until
+// the column is materialized a `NULL` element of `data2` isn't created yet,
+// which costs nothing for the `NULL` elements.
+inline R_xlen_t nested_df_length(SEXP x) {
+  SEXP info = R_altrep_data1(x);
+  return Rf_isNull(info) ? Rf_xlength(R_altrep_data2(x)) : Rf_xlength(VECTOR_ELT(info, 2));
+}
+
+inline SEXP nested_df_cache(SEXP x) {
+  SEXP data2 = R_altrep_data2(x);
+  if (Rf_isNull(data2)) {
+    data2 = Rf_allocVector(VECSXP, nested_df_length(x));
+    R_set_altrep_data2(x, data2);
+  }
+  return data2;
+}
+
+inline SEXP nested_df_materialize(SEXP x) {
+  SEXP info = R_altrep_data1(x);
+  SEXP data2 = nested_df_cache(x);
+  if (!Rf_isNull(info)) {
+    for (R_xlen_t i = 0; i < Rf_xlength(data2); i++) {
+      if (Rf_isNull(VECTOR_ELT(data2, i))) {
+        SET_VECTOR_ELT(data2, i, nested_df_element(info, i));
+      }
+    }
+    R_set_altrep_data1(x, R_NilValue);
+  }
+  return data2;
+}
+
+inline void* nested_df_dataptr(SEXP x, Rboolean /* writeable */) {
+  return const_cast<void*>(DATAPTR_RO(nested_df_materialize(x)));
+}
+
+inline const void* nested_df_dataptr_or_null(SEXP x) {
+  if (!Rf_isNull(R_altrep_data1(x))) {
+    return nullptr;
+  }
+  return DATAPTR_RO(R_altrep_data2(x));
+}
+
+// an element is created once and then kept in `data2`
+inline SEXP nested_df_elt(SEXP x, R_xlen_t i) {
+  SEXP info = R_altrep_data1(x);
+  if (Rf_isNull(info)) {
+    return VECTOR_ELT(R_altrep_data2(x), i);
+  }
+
+  SEXP data2 = nested_df_cache(x);
+  SEXP out = VECTOR_ELT(data2, i);
+  if (Rf_isNull(out)) {
+    out = nested_df_element(info, i);
+    SET_VECTOR_ELT(data2, i, out);
+  }
+  return out;
+}
+
+inline void nested_df_set_elt(SEXP x, R_xlen_t i, SEXP value) {
+  SET_VECTOR_ELT(nested_df_materialize(x), i, value);
+}
+
+// a copy that isn't materialized shares the `info` list, which is never modified
+inline SEXP nested_df_duplicate(SEXP x, Rboolean deep) {
+  SEXP info = R_altrep_data1(x);
+  if (Rf_isNull(info)) {
+    return deep ? Rf_duplicate(R_altrep_data2(x)) : Rf_shallow_duplicate(R_altrep_data2(x));
+  }
+  return R_new_altrep(nested_df_class, info, R_NilValue);
+}
+
+// `list(data1, data2)`
+inline SEXP nested_df_serialized_state(SEXP x) {
+  SEXP state = PROTECT(Rf_allocVector(VECSXP, 2));
+  SET_VECTOR_ELT(state, 0, R_altrep_data1(x));
+  SET_VECTOR_ELT(state, 1, R_altrep_data2(x));
+  UNPROTECT(1);
+  return state;
+}
+
+inline SEXP nested_df_unserialize(SEXP /* cls */, SEXP state) {
+  return R_new_altrep(nested_df_class, VECTOR_ELT(state, 0), VECTOR_ELT(state, 1));
+}
+
+inline Rboolean nested_df_inspect(SEXP x, int /* pre */, int /* deep */, int /* pvec */,
+                                  void (* /* inspect_subtree */)(SEXP, int, int, int)) {
+  bool materialized = Rf_isNull(R_altrep_data1(x));
+  Rprintf("jsonparse::nested_df (len=%td, %s)\n", static_cast<ptrdiff_t>(nested_df_length(x)),
+          materialized ? "materialized" : "lazy");
+  return TRUE;
+}
+
+#endif
+
+inline void register_nested_df_class(DllInfo* dll) {
+#if R_VERSION >= R_Version(4, 3, 0)
+  nested_df_class = R_make_altlist_class("nested_df", "jsonparse", dll);
+  R_set_altrep_Length_method(nested_df_class, nested_df_length);
+  R_set_altvec_Dataptr_method(nested_df_class, nested_df_dataptr);
+  R_set_altvec_Dataptr_or_null_method(nested_df_class, nested_df_dataptr_or_null);
+  R_set_altlist_Elt_method(nested_df_class, nested_df_elt);
+  R_set_altlist_Set_elt_method(nested_df_class, nested_df_set_elt);
+  R_set_altrep_Duplicate_method(nested_df_class, nested_df_duplicate);
+  R_set_altrep_Serialized_state_method(nested_df_class, nested_df_serialized_state);
+  R_set_altrep_Unserialize_method(nested_df_class, nested_df_unserialize);
+  R_set_altrep_Inspect_method(nested_df_class, nested_df_inspect);
+#endif
+}
+
+// `rows` is a data frame; a regular list if the ALTREP class isn't registered,
+// e.g. in the tests
+inline SEXP new_nested_dfs(SEXP rows, const std::vector<int>& starts, const std::vector<int>& lengths,
+                           Df_Class df_class) {
+  SEXP info = PROTECT(Rf_allocVector(VECSXP, 4));
+  SET_VECTOR_ELT(info, 0, rows);
+
+  SEXP starts_sexp = Rf_allocVector(INTSXP, starts.size());
+  SET_VECTOR_ELT(info, 1, starts_sexp);
+  std::copy(starts.begin(), starts.end(), INTEGER(starts_sexp));
+
+  SEXP lengths_sexp = Rf_allocVector(INTSXP, lengths.size());
+  SET_VECTOR_ELT(info, 2, lengths_sexp);
+  std::copy(lengths.begin(), lengths.end(), INTEGER(lengths_sexp));
+
+  SET_VECTOR_ELT(info, 3, Rf_ScalarInteger(static_cast<int>(df_class)));
+
+  SEXP out;
+  if (nested_df_class.ptr != nullptr) {
+    out = R_new_altrep(nested_df_class, info, R_NilValue);
+  } else {
+    out = materialize_nested_dfs(info);
+  }
+
+  UNPROTECT(1);
+  return out;
+}
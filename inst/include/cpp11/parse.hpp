@@ -3,11 +3,53 @@
 #define STRICT_R_HEADERS
 #include "cpp11.hpp"
 #include "json_utils.hpp"
+#include "datetime.hpp"
+#include "column_buffer.hpp"
+
+#include <climits>
+#include <limits>
 
 using simdjson::ondemand::json_type;
 
 inline auto bad_json_type_message(simdjson::ondemand::value element, const std::string& expected, const JSON_Path& path) {
-    return "Cannot convert a JSON " + json_type_to_string(element) + " to " + expected + " at path " + path.path();
+    return "Cannot convert a JSON " + json_type_to_string(element) + " to " + expected + " at path " + path_of(element, path);
+}
+
+// The caller continues with a missing value if this returns, see `raise_problem()`.
+inline void bad_json_type(simdjson::ondemand::value element, const std::string& expected, const JSON_Path& path) {
+    raise_problem(element, expected, json_type_to_string(element), path, [&]() {
+        throw std::runtime_error(bad_json_type_message(element, expected, path));
+    });
+}
+
+// a number that has the right JSON type but doesn't fit into `expected`
+inline void bad_number(simdjson::ondemand::value element, const std::string& expected, const JSON_Path& path) {
+    std::string x = std::string(element.raw_json_token());
+    x.erase(x.find_last_not_of(" \t\n\r") + 1);
+    raise_problem(element, expected, x, path, [&]() {
+        throw std::runtime_error("Cannot convert the JSON number " + x + " to " + expected + " at path " + path_of(element, path));
+    });
+}
+
+// R strings cannot contain NUL, so a string with the escape sequence `\u0000`
+// is a problem. The caller continues with `NA` if this returns.
+inline void bad_nul_string(simdjson::ondemand::value element, const JSON_Path& path) {
+    raise_problem(element, "string", "string with NUL", path, [&]() {
+        throw std::runtime_error("Cannot convert a JSON string with NUL to an R string at path " + path_of(element, path));
+    });
+}
+
+// The content of a string that `append_unescaped()` rejected, unescaped by
+// simdjson so that it reports an invalid escape sequence. `false` if it was
+// rejected for `\u0000`; this is reported with `bad_nul_string()`.
+inline bool unescape_rejected_string(simdjson::ondemand::value element, const JSON_Path& path, std::string_view& out) {
+    out = std::string_view(element);
+    if (out.find('\0') == std::string_view::npos) {
+        return true;
+    }
+
+    bad_nul_string(element, path);
+    return false;
 }
 
 // Cannot use template function because
@@ -22,21 +64,29 @@ inline int parse_scalar_bool(simdjson::ondemand::value element, JSON_Path& path)
         return NA_LOGICAL;
         break;
     default:
-        throw std::runtime_error(bad_json_type_message(element, "bool", path));
+        bad_json_type(element, "bool", path);
+        return NA_LOGICAL;
     }
 }
 
 inline int parse_scalar_int(simdjson::ondemand::value element, const JSON_Path& path) {
     switch (element.type()) {
-    case json_type::number:
-        // TODO this is unsafe; add handling of big integers
-        return static_cast<int>(int64_t(element));
+    case json_type::number: {
+        // `INT_MIN` is `NA_integer_` in R
+        int64_t x;
+        if (element.get_int64().get(x) || x > INT_MAX || x <= INT_MIN) {
+            bad_number(element, "int", path);
+            return NA_INTEGER;
+        }
+        return static_cast<int>(x);
         break;
+    }
     case json_type::null:
         return NA_INTEGER;
         break;
     default:
-        throw std::runtime_error(bad_json_type_message(element, "int", path));
+        bad_json_type(element, "int", path);
+        return NA_INTEGER;
     }
 }
 
@@ -49,42 +99,287 @@ inline double parse_scalar_double(simdjson::ondemand::value element, const JSON_
         return NA_REAL;
         break;
     default:
-        throw std::runtime_error(bad_json_type_message(element, "double", path));
+        bad_json_type(element, "double", path);
+        return NA_REAL;
     }
 }
 
+// simdjson has already validated the input as UTF-8
 inline SEXPREC* parse_scalar_string(simdjson::ondemand::value element, const JSON_Path& path) {
     switch (element.type()) {
-    case json_type::string:
-        return Rf_mkChar(std::string(std::string_view(element)).c_str());
+    case json_type::string: {
+        std::string_view raw = raw_string_content(element);
+        if (raw.find('\\') == std::string_view::npos) {
+            return mk_utf8_char(raw);
+        }
+
+        // reused so that unescaping doesn't allocate per string
+        static std::string unescaped;
+        unescaped.clear();
+        if (append_unescaped(raw, unescaped)) {
+            return mk_utf8_char(unescaped);
+        }
+
+        std::string_view x;
+        if (!unescape_rejected_string(element, path, x)) {
+            return NA_STRING;
+        }
+        return mk_utf8_char(x);
         break;
+    }
     case json_type::null:
         return NA_STRING;
         break;
     default:
-        throw std::runtime_error(bad_json_type_message(element, "string", path));
+        bad_json_type(element, "string", path);
+        return NA_STRING;
+    }
+}
+
+// Appends a string or null to `buffer`. Escaped strings are unescaped straight
+// into the buffer instead of going through simdjson's string buffer first.
+inline void append_scalar_string(String_Buffer& buffer, simdjson::ondemand::value element, const JSON_Path& path) {
+    switch (element.type()) {
+    case json_type::string: {
+        std::string_view raw = raw_string_content(element);
+        if (raw.find('\\') == std::string_view::npos) {
+            buffer.push_back(raw);
+        } else if (!buffer.push_back_with([&](std::string& chars) { return append_unescaped(raw, chars); })) {
+            std::string_view x;
+            if (unescape_rejected_string(element, path, x)) {
+                buffer.push_back(x);
+            } else {
+                buffer.push_null();
+            }
+        }
+        break;
+    }
+    case json_type::null:
+        buffer.push_null();
+        break;
+    default:
+        bad_json_type(element, "string", path);
+        buffer.push_null();
+    }
+}
+
+inline auto bad_datetime_message(simdjson::ondemand::value element, std::string_view x, const std::string& expected, const JSON_Path& path) {
+    return "Cannot parse \"" + std::string(x) + "\" as " + expected + " at path " + path_of(element, path);
+}
+
+// seconds since 1970-01-01 UTC
+inline double parse_scalar_datetime(simdjson::ondemand::value element, const JSON_Path& path) {
+    switch (element.type()) {
+    case json_type::string: {
+        std::string_view x = string_content(element);
+        double out;
+        if (!parse_iso8601_datetime(x, out)) {
+            raise_problem(element, "datetime", std::string(x), path, [&]() {
+                throw std::runtime_error(bad_datetime_message(element, x, "datetime", path));
+            });
+            return NA_REAL;
+        }
+        return out;
+        break;
+    }
+    case json_type::null:
+        return NA_REAL;
+        break;
+    default:
+        bad_json_type(element, "datetime", path);
+        return NA_REAL;
+    }
+}
+
+// days since 1970-01-01
+inline double parse_scalar_date(simdjson::ondemand::value element, const JSON_Path& path) {
+    switch (element.type()) {
+    case json_type::string: {
+        std::string_view x = string_content(element);
+        double out;
+        if (!parse_iso8601_date(x, out)) {
+            raise_problem(element, "date", std::string(x), path, [&]() {
+                throw std::runtime_error(bad_datetime_message(element, x, "date", path));
+            });
+            return NA_REAL;
+        }
+        return out;
+        break;
+    }
+    case json_type::null:
+        return NA_REAL;
+        break;
+    default:
+        bad_json_type(element, "date", path);
+        return NA_REAL;
+    }
+}
+
+// `unit` is one of "s", "ms", "us" or "ns"
+inline int64_t epoch_units_per_second(const std::string& unit) {
+    if (unit == "s") return 1;
+    if (unit == "ms") return 1000;
+    if (unit == "us") return 1000000;
+    if (unit == "ns") return 1000000000;
+
+    cpp11::stop("Unsupported epoch unit `%s`.", unit.c_str());
+}
+
+// an epoch number in `units_per_second` to seconds since 1970-01-01 UTC
+inline double parse_scalar_epoch(simdjson::ondemand::value element, int64_t units_per_second, const JSON_Path& path) {
+    switch (element.type()) {
+    case json_type::number:
+        if (element.get_number_type() == simdjson::ondemand::number_type::signed_integer) {
+            // split before converting so that nanoseconds keep as much precision as a double allows
+            int64_t x = int64_t(element);
+            int64_t seconds = x / units_per_second;
+            int64_t rest = x % units_per_second;
+            return static_cast<double>(seconds) + static_cast<double>(rest) / units_per_second;
+        }
+        return double(element) / units_per_second;
+        break;
+    case json_type::null:
+        return NA_REAL;
+        break;
+    default:
+        bad_json_type(element, "epoch timestamp", path);
+        return NA_REAL;
+    }
+}
+
+// bit64's `NA_integer64_`
+const int64_t NA_INTEGER64 = std::numeric_limits<int64_t>::min();
+
+// an epoch number in `units_per_second` to nanoseconds since 1970-01-01 UTC
+inline int64_t parse_scalar_epoch_ns(simdjson::ondemand::value element, int64_t units_per_second, const JSON_Path& path) {
+    const int64_t factor = 1000000000 / units_per_second;
+    switch (element.type()) {
+    case json_type::number:
+        if (element.get_number_type() == simdjson::ondemand::number_type::signed_integer) {
+            int64_t x = int64_t(element);
+            if (x > std::numeric_limits<int64_t>::max() / factor || x < -std::numeric_limits<int64_t>::max() / factor) {
+                bad_number(element, "epoch timestamp", path);
+                return NA_INTEGER64;
+            }
+            return x * factor;
+        }
+        {
+            // `NA_integer64_` is the smallest int64 and not a valid value
+            double x = double(element) * factor;
+            if (!(x > -9223372036854775808.0 && x < 9223372036854775808.0)) {
+                bad_number(element, "epoch timestamp", path);
+                return NA_INTEGER64;
+            }
+            return static_cast<int64_t>(x);
+        }
+        break;
+    case json_type::null:
+        return NA_INTEGER64;
+        break;
+    default:
+        bad_json_type(element, "epoch timestamp", path);
+        return NA_INTEGER64;
+    }
+}
+
+template <typename T>
+inline T na_value();
+
+template <>
+inline int na_value<int>() {
+    return NA_INTEGER;
+}
+
+template <>
+inline double na_value<double>() {
+    return NA_REAL;
+}
+
+template <typename T>
+inline T parse_scalar_number(simdjson::ondemand::value element, const JSON_Path& path);
+
+template <>
+inline int parse_scalar_number<int>(simdjson::ondemand::value element, const JSON_Path& path) {
+    return parse_scalar_int(element, path);
+}
+
+template <>
+inline double parse_scalar_number<double>(simdjson::ondemand::value element, const JSON_Path& path) {
+    return parse_scalar_double(element, path);
+}
+
+// a row of a matrix that doesn't have the length of the other rows
+inline void bad_array_length(simdjson::ondemand::value json, R_xlen_t expected, R_xlen_t actual, const JSON_Path& path) {
+    std::string expected_str = "array of length " + std::to_string(expected);
+    std::string actual_str = "array of length " + std::to_string(actual);
+    raise_problem(json, expected_str, actual_str, path, [&]() {
+        throw std::runtime_error("Expected an " + expected_str + " but got an " + actual_str + " at path " + path_of(json, path));
+    });
+}
+
+// Decodes a plain number without looking at the type first; `false` for
+// anything else, e.g. `null`, a string or an int out of range. A failed get
+// doesn't consume the value, so it can still be parsed the regular way.
+template <typename T>
+inline bool decode_plain_number(simdjson::ondemand::value element, T& out);
+
+template <>
+inline bool decode_plain_number<int>(simdjson::ondemand::value element, int& out) {
+    int64_t x;
+    if (element.get_int64().get(x) || x > INT_MAX || x <= INT_MIN) {
+        return false;
+    }
+    out = static_cast<int>(x);
+    return true;
+}
+
+template <>
+inline bool decode_plain_number<double>(simdjson::ondemand::value element, double& out) {
+    return !element.get_double().get(out);
+}
+
+// The number `element` as `T`. A plain number is decoded directly; only the
+// other values, e.g. `null`, go through the type switch of
+// `parse_scalar_number()`. All int and double columns and arrays parse their
+// numbers with this.
+template <typename T>
+inline T parse_number(simdjson::ondemand::value element, const JSON_Path& path) {
+    T out;
+    if (decode_plain_number<T>(element, out)) {
+        return out;
+    }
+    return parse_scalar_number<T>(element, path);
+}
+
+// Writes the numbers of `array` to `out[0], out[stride], ...`, e.g. to a row
+// of a column-major matrix with `stride` rows.
+template <typename T>
+inline void parse_number_array(simdjson::ondemand::array array, R_xlen_t stride, T* out, JSON_Path& path) {
+    for (auto element : array) {
+        *out = parse_number<T>(element.value(), path);
+        out += stride;
     }
 }
 
+// `NULL` if `json` is no array and the problem was recorded instead
 template <typename T>
 inline SEXP parse_homo_array(simdjson::ondemand::value json, JSON_Path& path);
 
 template <>
 inline SEXP parse_homo_array<bool>(simdjson::ondemand::value json, JSON_Path& path) {
-    simdjson::ondemand::array array = safe_get_array(json, path);
+    simdjson::ondemand::array array;
+    if (!safe_get_array(json, path, array)) {
+        return R_NilValue;
+    }
 
     int n = array.count_elements();
     SEXP out = PROTECT(Rf_allocVector(LGLSXP, n));
     int* pout = LOGICAL(out);
 
-    int i = 0;
-    path.insert_dummy<int>();
     for (auto element : array) {
-        path.replace(i++);
         *pout = parse_scalar_bool(element.value(), path);
         ++pout;
     }
-    path.drop();
 
     UNPROTECT(1);
     return out;
@@ -92,20 +387,14 @@ inline SEXP parse_homo_array<bool>(simdjson::ondemand::value json, JSON_Path& pa
 
 template<>
 inline SEXP parse_homo_array<int>(simdjson::ondemand::value json, JSON_Path& path) {
-    simdjson::ondemand::array array = safe_get_array(json, path);
+    simdjson::ondemand::array array;
+    if (!safe_get_array(json, path, array)) {
+        return R_NilValue;
+    }
 
     int n = array.count_elements();
     SEXP out = PROTECT(Rf_allocVector(INTSXP, n));
-    int* pout = INTEGER(out);
-
-    int i = 0;
-    path.insert_dummy<int>();
-    for (auto element : array) {
-        path.replace(i++);
-        *pout = parse_scalar_int(element.value(), path);
-        ++pout;
-    }
-    path.drop();
+    parse_number_array<int>(array, 1, INTEGER(out), path);
 
     UNPROTECT(1);
     return out;
@@ -113,20 +402,14 @@ inline SEXP parse_homo_array<int>(simdjson::ondemand::value json, JSON_Path& pat
 
 template<>
 inline SEXP parse_homo_array<double>(simdjson::ondemand::value json, JSON_Path& path) {
-    simdjson::ondemand::array array = safe_get_array(json, path);
+    simdjson::ondemand::array array;
+    if (!safe_get_array(json, path, array)) {
+        return R_NilValue;
+    }
 
     int n = array.count_elements();
     SEXP out = PROTECT(Rf_allocVector(REALSXP, n));
-    double* pout = REAL(out);
-
-    int i = 0;
-    path.insert_dummy<int>();
-    for (auto element : array) {
-        path.replace(i++);
-        *pout = parse_scalar_double(element.value(), path);
-        ++pout;
-    }
-    path.drop();
+    parse_number_array<double>(array, 1, REAL(out), path);
 
     UNPROTECT(1);
     return out;
@@ -134,19 +417,19 @@ inline SEXP parse_homo_array<double>(simdjson::ondemand::value json, JSON_Path&
 
 template<>
 inline SEXP parse_homo_array<std::string>(simdjson::ondemand::value json, JSON_Path& path) {
-    simdjson::ondemand::array array = safe_get_array(json, path);
+    simdjson::ondemand::array array;
+    if (!safe_get_array(json, path, array)) {
+        return R_NilValue;
+    }
 
     int n = array.count_elements();
     SEXP out = PROTECT(Rf_allocVector(STRSXP, n));
 
     int i = 0;
-    path.insert_dummy<int>();
     for (auto element : array) {
-        path.replace(i);
         SET_STRING_ELT(out, i, parse_scalar_string(element.value(), path));
         i++;
     }
-    path.drop();
 
     UNPROTECT(1);
     return out;
@@ -5,9 +5,153 @@ T parse_default_value(cpp11::sexp default_sexp) {
     return T(cpp11::r_vector<T>(default_sexp)[0]);
 }
 
-std::pair<std::unordered_map<std::string, std::unique_ptr<Column>>, std::vector<std::string>> parse_sub_spec(cpp11::list spec) {
+// `filter_spec` is `NULL` or a list of `list(path = , op = , value = )`
+std::vector<std::pair<std::string, Row_Filter>> parse_filter_spec(SEXP filter_spec) {
+    std::vector<std::pair<std::string, Row_Filter>> filters;
+    if (Rf_isNull(filter_spec)) {
+        return filters;
+    }
+
+    for (cpp11::list element : cpp11::list(filter_spec)) {
+        std::string key = cpp11::r_string(cpp11::strings(element["path"])[0]);
+        std::string op = cpp11::r_string(cpp11::strings(element["op"])[0]);
+        cpp11::sexp value = element["value"];
+
+        if (TYPEOF(value) == STRSXP) {
+            std::string value_str = cpp11::r_string(cpp11::strings(value)[0]);
+            filters.push_back({key, Row_Filter(op, value_str)});
+        } else {
+            filters.push_back({key, Row_Filter(op, Rf_asReal(value))});
+        }
+    }
+
+    return filters;
+}
+
+// reads the optional `skip`, `n_max`, `sample_fraction` and `sample_size` of a df spec
+Row_Sampler parse_row_sampler(cpp11::list element) {
+    int skip = Rf_isNull(element["skip"]) ? 0 : Rf_asInteger(element["skip"]);
+    int n_max = Rf_isNull(element["n_max"]) ? -1 : Rf_asInteger(element["n_max"]);
+    double sample_fraction = Rf_isNull(element["sample_fraction"]) ? 1 : Rf_asReal(element["sample_fraction"]);
+    int sample_size = Rf_isNull(element["sample_size"]) ? -1 : Rf_asInteger(element["sample_size"]);
+
+    if (skip == NA_INTEGER || skip < 0) {
+        cpp11::stop("`skip` must be a non-negative integer.");
+    }
+    if (n_max == NA_INTEGER) {
+        n_max = -1;
+    }
+    if (ISNAN(sample_fraction) || sample_fraction < 0 || sample_fraction > 1) {
+        cpp11::stop("`sample_fraction` must be between 0 and 1.");
+    }
+    if (sample_size == NA_INTEGER) {
+        sample_size = -1;
+    }
+
+    return Row_Sampler(skip, n_max, sample_fraction, sample_size);
+}
+
+// reads the optional `unit` of a `timestamp_epoch` spec; seconds by default
+std::string parse_epoch_unit(cpp11::list element) {
+    return Rf_isNull(element["unit"]) ? "s" : cpp11::r_string(cpp11::strings(element["unit"])[0]);
+}
+
+// `true` if a `timestamp_epoch` spec asks for `as = "integer64"`
+bool parse_epoch_as_integer64(cpp11::list element) {
+    return !Rf_isNull(element["as"]) && cpp11::r_string(cpp11::strings(element["as"])[0]) == "integer64";
+}
+
+// reads the optional `width` of a matrix spec; -1 if it is taken from the data
+int parse_matrix_width(cpp11::list element) {
+    if (Rf_isNull(element["width"])) {
+        return -1;
+    }
+
+    int width = Rf_asInteger(element["width"]);
+    if (width == NA_INTEGER || width < 0) {
+        cpp11::stop("`width` must be a non-negative integer.");
+    }
+    return width;
+}
+
+// reads the optional `as` of a df spec
+Df_Class parse_df_class_spec(cpp11::list element) {
+    if (Rf_isNull(element["as"])) {
+        return Df_Class::tibble;
+    }
+
+    return parse_df_class(cpp11::r_string(cpp11::strings(element["as"])[0]));
+}
+
+// reads the optional `unnest` of a df_vec spec
+bool parse_unnest(cpp11::list element) {
+    return !Rf_isNull(element["unnest"]) && Rf_asLogical(element["unnest"]) == TRUE;
+}
+
+// reads the optional `stats` of the top-level spec
+bool parse_stats_option(cpp11::list element) {
+    return !Rf_isNull(element["stats"]) && Rf_asLogical(element["stats"]) == TRUE;
+}
+
+// reads the optional `on_error` of the top-level spec
+Error_Mode parse_on_error(cpp11::list element) {
+    if (Rf_isNull(element["on_error"])) {
+        return Error_Mode::stop;
+    }
+
+    return parse_error_mode(cpp11::r_string(cpp11::strings(element["on_error"])[0]));
+}
+
+// reads the `value_type` of a map spec
+std::string parse_map_value_type(cpp11::list element) {
+    if (Rf_isNull(element["value_type"])) {
+        cpp11::stop("A map needs a `value_type`.");
+    }
+
+    std::string value_type = cpp11::r_string(cpp11::strings(element["value_type"])[0]);
+    if (value_type != "lgl" && value_type != "int" && value_type != "dbl" && value_type != "str") {
+        cpp11::stop("`value_type` must be one of \"lgl\", \"int\", \"dbl\" or \"str\".");
+    }
+    return value_type;
+}
+
+std::unique_ptr<Parser> parse_map_spec(cpp11::list element) {
+    std::string value_type = parse_map_value_type(element);
+
+    if (value_type == "lgl") {
+        return std::make_unique<Parser_Map<bool>>();
+    } else if (value_type == "int") {
+        return std::make_unique<Parser_Map<int>>();
+    } else if (value_type == "dbl") {
+        return std::make_unique<Parser_Map<double>>();
+    } else {
+        return std::make_unique<Parser_Map<std::string>>();
+    }
+}
+
+std::unique_ptr<Column> parse_map_column_spec(cpp11::list element) {
+    std::string value_type = parse_map_value_type(element);
+    SEXP default_sexp = element["default"];
+
+    if (value_type == "lgl") {
+        return std::make_unique<Column_Map<bool>>(default_sexp);
+    } else if (value_type == "int") {
+        return std::make_unique<Column_Map<int>>(default_sexp);
+    } else if (value_type == "dbl") {
+        return std::make_unique<Column_Map<double>>(default_sexp);
+    } else {
+        return std::make_unique<Column_Map<std::string>>(default_sexp);
+    }
+}
+
+// `allow_unnest` is `false` for the fields of a `df`, whose number of rows is
+// fixed, and of a `df_vec`, whose nested rows share one set of columns.
+// With `stats` every column records its statistics under `prefix/<path>`.
+std::pair<std::unordered_map<std::string, std::unique_ptr<Column>>, std::vector<std::string>> parse_sub_spec(cpp11::list spec, bool allow_unnest = true,
+                                                                                                          Parse_Stats* stats = nullptr, const std::string& prefix = "") {
     std::unordered_map<std::string, std::unique_ptr<Column>> fields;
     std::vector<std::string> col_order;
+    int n_unnested = 0;
 
     for (cpp11::list element : spec) {
         std::string type = cpp11::r_string(cpp11::strings(element["type"])[0]);
@@ -16,6 +160,8 @@ std::pair<std::unordered_map<std::string, std::unique_ptr<Column>>, std::vector<
         // cpp11::message(key);
         col_order.push_back(key);
         cpp11::sexp default_sexp = element["default"];
+        std::string col_path = prefix + "/" + key;
+        Column_Stats* col_stats = stats == nullptr ? nullptr : stats->add(col_path);
 
         if (type == "lgl") {
             cpp11::r_bool default_val = parse_default_value<cpp11::r_bool>(default_sexp);
@@ -29,6 +175,14 @@ std::pair<std::unordered_map<std::string, std::unique_ptr<Column>>, std::vector<
         } else if (type == "str") {
             auto default_val = parse_default_value<cpp11::r_string>(default_sexp);
             fields[key] = std::make_unique<Column_Scalar<std::string>>(default_val);
+        } else if (type == "auto") {
+            fields[key] = std::make_unique<Column_Adaptive>(default_sexp);
+        } else if (type == "datetime" || type == "date") {
+            double default_val = Rf_isNull(default_sexp) ? NA_REAL : Rf_asReal(default_sexp);
+            fields[key] = std::make_unique<Column_Datetime>(default_val, type == "date");
+        } else if (type == "timestamp_epoch") {
+            double default_val = Rf_isNull(default_sexp) ? NA_REAL : Rf_asReal(default_sexp);
+            fields[key] = std::make_unique<Column_Epoch>(parse_epoch_unit(element), parse_epoch_as_integer64(element), default_val);
         } else if (type == "lgl_vec") {
             if (Rf_isNull(default_sexp)) {
                 fields[key] = std::make_unique<Column_Vector<bool>>(cpp11::list());
@@ -57,29 +211,63 @@ std::pair<std::unordered_map<std::string, std::unique_ptr<Column>>, std::vector<
                 auto default_val = cpp11::strings(default_sexp);
                 fields[key] = std::make_unique<Column_Vector<std::string>>(default_val);
             }
+        } else if (type == "int_matrix") {
+            fields[key] = std::make_unique<Column_Matrix<int>>(parse_matrix_width(element));
+        } else if (type == "dbl_matrix") {
+            fields[key] = std::make_unique<Column_Matrix<double>>(parse_matrix_width(element));
+        } else if (type == "map") {
+            fields[key] = parse_map_column_spec(element);
         } else if (type == "df") {
-            auto spec_info = parse_sub_spec(element["fields"]);
-            fields[key] = std::make_unique<Column_Df>(spec_info.first, spec_info.second);
+            auto spec_info = parse_sub_spec(element["fields"], false, stats, col_path);
+            auto col = std::make_unique<Column_Df>(spec_info.first, spec_info.second);
+            col->set_stats(col_stats);
+            fields[key] = std::move(col);
+        } else if (type == "df_vec" && parse_unnest(element)) {
+            if (!allow_unnest) {
+                cpp11::stop("`unnest` is not supported for `%s` as it is inside a `df` or a `df_vec`.", key.c_str());
+            }
+            if (++n_unnested > 1) {
+                cpp11::stop("Only one `df_vec` per data frame can be unnested.");
+            }
+            auto spec_info = parse_sub_spec(element["fields"], false, stats, col_path);
+            std::string parent_row_name = Rf_isNull(element["parent_row"]) ? "" : cpp11::r_string(cpp11::strings(element["parent_row"])[0]);
+            auto col = std::make_unique<Column_UnnestedDf>(spec_info.first, spec_info.second,
+                                                           parse_filter_spec(element["filter"]), parent_row_name);
+            col->set_stats(col_stats);
+            fields[key] = std::move(col);
         } else if (type == "df_vec") {
-            auto spec_info = parse_sub_spec(element["fields"]);
-            fields[key] = std::make_unique<Column_ListOfDf>(spec_info.first, spec_info.second);
+            auto spec_info = parse_sub_spec(element["fields"], false, stats, col_path);
+            auto filters = parse_filter_spec(element["filter"]);
+            auto col = std::make_unique<Column_ListOfDf>(spec_info.first, spec_info.second, filters,
+                                                         parse_row_sampler(element), parse_df_class_spec(element));
+            col->set_stats(col_stats);
+            fields[key] = std::move(col);
         } else {
             cpp11::message(type);
             cpp11::stop("Unsupported type!");
         }
+
+        if (col_stats != nullptr) {
+            fields[key] = std::make_unique<Column_Instrumented>(std::move(fields[key]), col_stats);
+        }
     }
 
     return std::make_pair(std::move(fields), col_order);
 }
 
-Parser_Dataframe parse_spec_collector_df(cpp11::list spec) {
-    auto spec_info = parse_sub_spec(spec);
-    return Parser_Dataframe(spec_info.first, spec_info.second);
+// `element` is the spec of a `df`; `stats` and `prefix` as in `parse_sub_spec()`
+Parser_Dataframe parse_spec_collector_df(cpp11::list element, Parse_Stats* stats = nullptr, const std::string& prefix = "") {
+    auto spec_info = parse_sub_spec(element["fields"], true, stats, prefix);
+    return Parser_Dataframe(spec_info.first, spec_info.second,
+                            parse_filter_spec(element["filter"]),
+                            parse_row_sampler(element),
+                            parse_df_class_spec(element));
 }
 
-Parser_Object parse_spec_collector_object(cpp11::list spec) {
+Parser_Object parse_spec_collector_object(cpp11::list spec, Parse_Stats* stats = nullptr, const std::string& prefix = "") {
     std::unordered_map<std::string, std::unique_ptr<Parser>> fields;
     std::unordered_map<std::string, SEXP> default_values;
+    std::unordered_map<std::string, Column_Stats*> field_stats;
     std::vector<std::string> nms;
 
     for (cpp11::list element : spec) {
@@ -88,6 +276,8 @@ Parser_Object parse_spec_collector_object(cpp11::list spec) {
         // TODO must adapt to name
         nms.push_back(key);
         cpp11::sexp default_sexp = element["default"];
+        std::string field_path = prefix + "/" + key;
+        Column_Stats* col_stats = stats == nullptr ? nullptr : stats->add(field_path);
 
         if (type == "lgl") {
             fields[key] = std::make_unique<Parser_Scalar<bool>>();
@@ -101,6 +291,12 @@ Parser_Object parse_spec_collector_object(cpp11::list spec) {
         } else if (type == "str") {
             fields[key] = std::make_unique<Parser_Scalar<std::string>>();
             default_values[key] = cpp11::as_sexp(parse_default_value<cpp11::r_string>(default_sexp));
+        } else if (type == "datetime" || type == "date") {
+            fields[key] = std::make_unique<Parser_Datetime>(type == "date");
+            default_values[key] = default_sexp;
+        } else if (type == "timestamp_epoch") {
+            fields[key] = std::make_unique<Parser_Epoch>(parse_epoch_unit(element), parse_epoch_as_integer64(element));
+            default_values[key] = default_sexp;
         } else if (type == "lgl_vec") {
             fields[key] = std::make_unique<Parser_HomoArray<bool>>();
             default_values[key] = cpp11::logicals(default_sexp);
@@ -113,37 +309,77 @@ Parser_Object parse_spec_collector_object(cpp11::list spec) {
         } else if (type == "str_vec") {
             fields[key] = std::make_unique<Parser_HomoArray<std::string>>();
             default_values[key] = cpp11::strings(default_sexp);
+        } else if (type == "int_matrix") {
+            fields[key] = std::make_unique<Parser_Matrix<int>>(parse_matrix_width(element));
+            default_values[key] = default_sexp;
+        } else if (type == "dbl_matrix") {
+            fields[key] = std::make_unique<Parser_Matrix<double>>(parse_matrix_width(element));
+            default_values[key] = default_sexp;
+        } else if (type == "map") {
+            fields[key] = parse_map_spec(element);
+            default_values[key] = default_sexp;
         } else if (type == "list") {
-            fields[key] = std::make_unique<Parser_Object>(parse_spec_collector_object(element["fields"]));
+            auto parser = std::make_unique<Parser_Object>(parse_spec_collector_object(element["fields"], stats, field_path));
+            parser->set_stats(col_stats);
+            fields[key] = std::move(parser);
             default_values[key] = default_sexp;
         } else if (type == "df") {
-            fields[key] = std::make_unique<Parser_Dataframe>(parse_spec_collector_df(element["fields"]));
+            auto parser = std::make_unique<Parser_Dataframe>(parse_spec_collector_df(element, stats, field_path));
+            parser->set_stats(col_stats);
+            fields[key] = std::move(parser);
             default_values[key] = default_sexp;
         } else {
             cpp11::stop("Unsupported type!");
         }
+
+        if (col_stats != nullptr) {
+            fields[key] = std::make_unique<Parser_Instrumented>(std::move(fields[key]), col_stats);
+            field_stats[key] = col_stats;
+        }
     }
 
-    return Parser_Object(fields, default_values, nms);
+    Parser_Object out(fields, default_values, nms);
+    for (auto& it : field_stats) {
+        out.set_field_stats(it.first, it.second);
+    }
+    return out;
 }
 
-std::unique_ptr<Parser> parse_spec(cpp11::list element) {
+// With `stats` the top level records its statistics under the path `""`.
+std::unique_ptr<Parser> parse_spec(cpp11::list element, Parse_Stats* stats = nullptr) {
     std::string type = cpp11::r_string(cpp11::strings(element["type"])[0]);
+    Column_Stats* root_stats = stats == nullptr ? nullptr : stats->add("");
+    std::unique_ptr<Parser> out;
 
     if (type == "lgl_vec") {
-        return std::make_unique<Parser_HomoArray<bool>>();
+        out = std::make_unique<Parser_HomoArray<bool>>();
     } else if (type == "int_vec") {
-        return std::make_unique<Parser_HomoArray<int>>();
+        out = std::make_unique<Parser_HomoArray<int>>();
     } else if (type == "dbl_vec") {
-        return std::make_unique<Parser_HomoArray<double>>();
+        out = std::make_unique<Parser_HomoArray<double>>();
     } else if (type == "str_vec") {
-        return std::make_unique<Parser_HomoArray<std::string>>();
+        out = std::make_unique<Parser_HomoArray<std::string>>();
+    } else if (type == "int_matrix") {
+        out = std::make_unique<Parser_Matrix<int>>(parse_matrix_width(element));
+    } else if (type == "dbl_matrix") {
+        out = std::make_unique<Parser_Matrix<double>>(parse_matrix_width(element));
+    } else if (type == "map") {
+        out = parse_map_spec(element);
     } else if (type == "list") {
-        return std::make_unique<Parser_Object>(parse_spec_collector_object(element["fields"]));
+        auto parser = std::make_unique<Parser_Object>(parse_spec_collector_object(element["fields"], stats));
+        parser->set_stats(root_stats);
+        out = std::move(parser);
     } else if (type == "df") {
-        return std::make_unique<Parser_Dataframe>(parse_spec_collector_df(element["fields"]));
+        auto parser = std::make_unique<Parser_Dataframe>(parse_spec_collector_df(element, stats));
+        parser->set_stats(root_stats);
+        out = std::move(parser);
     } else {
         Rprintf(type.c_str());
         cpp11::stop("Unsupported type!");
     }
+
+    if (root_stats != nullptr) {
+        out = std::make_unique<Parser_Instrumented>(std::move(out), root_stats);
+    }
+    return out;
 }
@@ -0,0 +1,173 @@
+#pragma once
+
+#define STRICT_R_HEADERS
+#include "cpp11.hpp"
+#include "utils.hpp"
+
+#include <R_ext/Altrep.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// the time stamp counter where there is one, otherwise nanoseconds
+inline uint64_t read_cycle_counter() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()
+  ).count();
+#endif
+}
+
+// What one column or field of the spec saw during a parse. `cycles` include
+// the nested columns and the conversion to R.
+struct Column_Stats {
+  std::string path;
+  int64_t n_values = 0;
+  int64_t n_nulls = 0;
+  int64_t n_defaults = 0;
+  // the bytes of the strings as written in the JSON, i.e. before unescaping
+  int64_t string_bytes = 0;
+  // keys of an object that are not in the spec
+  int64_t n_unknown_keys = 0;
+  uint64_t cycles = 0;
+  // the bytes of the R objects created and the number of distinct `CHARSXP`s
+  // they refer to
+  int64_t r_bytes = 0;
+  int64_t n_charsxp = 0;
+  // the peak size of the native buffers before they are converted to R
+  int64_t buffer_bytes = 0;
+};
+
+// R's header of a vector (64-bit) and its data in units of 8 bytes, roughly
+// as `utils::object.size()` counts them
+inline int64_t r_vector_bytes(int64_t data_bytes) {
+  return 48 + (data_bytes + 7) / 8 * 8;
+}
+
+// The bytes of `x` and of the `CHARSXP`s that aren't in `strings` yet, which
+// are added to it. Attributes are not counted. ALTREP objects count their
+// compact representation.
+inline int64_t r_object_bytes(SEXP x, std::unordered_set<SEXP>& strings) {
+  if (ALTREP(x)) {
+    return r_object_bytes(R_altrep_data1(x), strings);
+  }
+
+  R_xlen_t n = Rf_xlength(x);
+  switch (TYPEOF(x)) {
+  case LGLSXP:
+  case INTSXP:
+    return r_vector_bytes(n * sizeof(int));
+  case REALSXP:
+    return r_vector_bytes(n * sizeof(double));
+  case STRSXP: {
+    int64_t out = r_vector_bytes(n * sizeof(SEXP));
+    for (R_xlen_t i = 0; i < n; i++) {
+      SEXP value = STRING_ELT(x, i);
+      if (value != NA_STRING && strings.insert(value).second) {
+        out += r_vector_bytes(LENGTH(value) + 1);
+      }
+    }
+    return out;
+  }
+  case VECSXP: {
+    int64_t out = r_vector_bytes(n * sizeof(SEXP));
+    for (R_xlen_t i = 0; i < n; i++) {
+      out += r_object_bytes(VECTOR_ELT(x, i), strings);
+    }
+    return out;
+  }
+  default:
+    return 0;
+  }
+}
+
+// adds the memory of `x`, a value created by the node of `stats`
+inline void count_r_memory(Column_Stats* stats, SEXP x) {
+  std::unordered_set<SEXP> strings;
+  stats->r_bytes += r_object_bytes(x, strings);
+  stats->n_charsxp += strings.size();
+}
+
+// The statistics of all nodes of a spec with `stats = TRUE`, in spec order.
+class Parse_Stats {
+private:
+  // pointers so that the entries stay put while the spec is parsed
+  std::vector<std::unique_ptr<Column_Stats>> columns;
+  int64_t parser_capacity = 0;
+
+public:
+  // `path` is like `/a/b` and empty for the top level
+  inline Column_Stats* add(std::string path) {
+    this->columns.push_back(std::make_unique<Column_Stats>());
+    this->columns.back()->path = std::move(path);
+    return this->columns.back().get();
+  }
+
+  // the largest document the simdjson parser was sized for
+  inline void set_parser_capacity(int64_t capacity) {
+    this->parser_capacity = std::max(this->parser_capacity, capacity);
+  }
+
+  inline int size() const {
+    return this->columns.size();
+  }
+
+  // a tibble with a row per node; the counts are doubles as they may exceed
+  // the integer range
+  inline SEXP get_value() const {
+    int n = this->size();
+    SEXP out = PROTECT(new_df({"path", "n_values", "n_nulls", "n_defaults", "string_bytes", "n_unknown_keys", "cycles",
+                               "r_bytes", "n_charsxp", "buffer_bytes"}, n));
+
+    SEXP path = Rf_allocVector(STRSXP, n);
+    SET_VECTOR_ELT(out, 0, path);
+    std::vector<double*> counts;
+    for (int j = 1; j < 10; j++) {
+      SEXP x = Rf_allocVector(REALSXP, n);
+      SET_VECTOR_ELT(out, j, x);
+      counts.push_back(REAL(x));
+    }
+
+    for (int i = 0; i < n; i++) {
+      const Column_Stats& stats = *this->columns[i];
+      SET_STRING_ELT(path, i, mk_utf8_char(stats.path));
+      counts[0][i] = stats.n_values;
+      counts[1][i] = stats.n_nulls;
+      counts[2][i] = stats.n_defaults;
+      counts[3][i] = stats.string_bytes;
+      counts[4][i] = stats.n_unknown_keys;
+      counts[5][i] = stats.cycles;
+      counts[6][i] = stats.r_bytes;
+      counts[7][i] = stats.n_charsxp;
+      counts[8][i] = stats.buffer_bytes;
+    }
+    SEXP capacity = PROTECT(Rf_ScalarReal(this->parser_capacity));
+    Rf_setAttrib(out, Rf_install("parser_capacity"), capacity);
+    UNPROTECT(1);
+
+    UNPROTECT(1);
+    return out;
+  }
+
+  // the statistics become the attribute `parse_stats` of `x`
+  inline void attach_to(SEXP x) const {
+    if (x == R_NilValue) {
+      return;
+    }
+
+    SEXP value = PROTECT(this->get_value());
+    Rf_setAttrib(x, Rf_install("parse_stats"), value);
+    UNPROTECT(1);
+  }
+};
@@ -7,6 +7,13 @@
 #if __cplusplus >= 201703L
 #include <cpp11/parse.hpp>
 #include <cpp11/utils.hpp>
+#include <cpp11/row_filter.hpp>
+#include <cpp11/row_sampler.hpp>
+#include <cpp11/ndjson.hpp>
+#include <cpp11/arrow_export.hpp>
+#include <cpp11/materialize.hpp>
+#include <cpp11/parse_stats.hpp>
+#include <cstring>
 #include <unordered_map>
 #include <memory>
 #endif
@@ -20,7 +27,27 @@ public:
   virtual inline void reserve(int n) = 0;
   virtual inline void add_value(simdjson::ondemand::value, JSON_Path& path) = 0;
   virtual inline void finalize_row() = 0;
+  // drop the current row, i.e. undo `add_value()` since the last `finalize_row()`
+  virtual inline void discard_row() = 0;
   virtual inline SEXP get_value() = 0;
+
+  // For a column that is unnested into its data frame: the row of the data
+  // frame (0-based) that each of its rows belongs to. `nullptr` otherwise.
+  virtual inline const std::vector<int>* get_parent_rows() {
+    return nullptr;
+  }
+
+  // The bytes held by the native buffers of the column, for the statistics.
+  // Columns that parse straight into R vectors hold none.
+  virtual inline int64_t buffer_bytes() {
+    return 0;
+  }
+
+  // Moves the values into `schema`/`array` (Arrow C data interface) instead of
+  // creating an R vector. Only columns with native storage support this.
+  virtual inline void export_arrow(const std::string& name, bool /* dictionary */, ArrowSchema* /* schema */, ArrowArray* /* array */) {
+    cpp11::stop("Column `%s` cannot be exported to Arrow.", name.c_str());
+  }
 };
 
 class Parser {
@@ -30,6 +57,49 @@ public:
   virtual inline SEXP parse_json(simdjson::ondemand::value, JSON_Path& path) = 0;
 };
 
+// counts `json` for the statistics before it is parsed
+inline void count_value(Column_Stats* stats, simdjson::ondemand::value json) {
+  stats->n_values++;
+  switch (json.type()) {
+  case simdjson::ondemand::json_type::null:
+    stats->n_nulls++;
+    break;
+  case simdjson::ondemand::json_type::string: {
+    std::string_view token = json.raw_json_token();
+    size_t end = token.rfind('"');
+    if (end != std::string_view::npos && end > 0) {
+      stats->string_bytes += end - 1;
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+// Wraps a parser to record what it sees (spec option `stats = TRUE`)
+class Parser_Instrumented : public virtual Parser {
+protected:
+  std::unique_ptr<Parser> parser;
+  Column_Stats* stats;
+
+public:
+  Parser_Instrumented(std::unique_ptr<Parser> parser, Column_Stats* stats) {
+    this->parser = std::move(parser);
+    this->stats = stats;
+  }
+
+  inline SEXP parse_json(simdjson::ondemand::value json, JSON_Path& path) {
+    count_value(this->stats, json);
+    uint64_t start = read_cycle_counter();
+    SEXP out = PROTECT((*this->parser).parse_json(json, path));
+    this->stats->cycles += read_cycle_counter() - start;
+    count_r_memory(this->stats, out);
+    UNPROTECT(1);
+    return out;
+  }
+};
+
 template <typename T>
 class Parser_Scalar : public virtual Parser {};
 
@@ -45,7 +115,7 @@ template <>
 class Parser_Scalar<int> : public virtual Parser {
 public:
   inline SEXP parse_json(simdjson::ondemand::value json, JSON_Path& path) {
-    return Rf_ScalarInteger(parse_scalar_int(json, path));
+    return Rf_ScalarInteger(parse_number<int>(json, path));
   }
 };
 
@@ -53,7 +123,7 @@ template <>
 class Parser_Scalar<double> : public virtual Parser {
 public:
   inline SEXP parse_json(simdjson::ondemand::value json, JSON_Path& path) {
-    return Rf_ScalarReal(parse_scalar_double(json, path));
+    return Rf_ScalarReal(parse_number<double>(json, path));
   }
 };
 
@@ -65,7 +135,58 @@ public:
   }
 };
 
+class Parser_Datetime : public virtual Parser {
+protected:
+  bool is_date;
+
+public:
+  Parser_Datetime(bool is_date) {
+    this->is_date = is_date;
+  }
 
+  inline SEXP parse_json(simdjson::ondemand::value json, JSON_Path& path) {
+    SEXP out;
+    if (this->is_date) {
+      out = PROTECT(Rf_ScalarReal(parse_scalar_date(json, path)));
+      set_date_class(out);
+    } else {
+      out = PROTECT(Rf_ScalarReal(parse_scalar_datetime(json, path)));
+      set_datetime_class(out);
+    }
+
+    UNPROTECT(1);
+    return out;
+  }
+};
+
+// an epoch number as a date-time, or as nanoseconds in an `integer64`
+class Parser_Epoch : public virtual Parser {
+protected:
+  int64_t units_per_second;
+  bool as_integer64;
+
+public:
+  Parser_Epoch(const std::string& unit, bool as_integer64) {
+    this->units_per_second = epoch_units_per_second(unit);
+    this->as_integer64 = as_integer64;
+  }
+
+  inline SEXP parse_json(simdjson::ondemand::value json, JSON_Path& path) {
+    SEXP out;
+    if (this->as_integer64) {
+      int64_t x = parse_scalar_epoch_ns(json, this->units_per_second, path);
+      out = PROTECT(Rf_allocVector(REALSXP, 1));
+      std::memcpy(REAL(out), &x, sizeof(int64_t));
+      set_integer64_class(out);
+    } else {
+      out = PROTECT(Rf_ScalarReal(parse_scalar_epoch(json, this->units_per_second, path)));
+      set_datetime_class(out);
+    }
+
+    UNPROTECT(1);
+    return out;
+  }
+};
 
 template <typename T>
 class Parser_HomoArray : public virtual Parser {
@@ -75,6 +196,114 @@ public:
   }
 };
 
+// An array of arrays of `width` numbers as one matrix with a row per inner
+// array. Without a declared width (-1) it is taken from the first row; rows of
+// another length are reported and become `NA`.
+template <typename T>
+class Parser_Matrix : public virtual Parser {
+protected:
+  int declared_width;
+
+public:
+  Parser_Matrix(int width) {
+    this->declared_width = width;
+  }
+
+  inline SEXP parse_json(simdjson::ondemand::value json, JSON_Path& path) {
+    simdjson::ondemand::array rows;
+    if (json.type() == simdjson::ondemand::json_type::null || !safe_get_array(json, path, rows)) {
+      return R_NilValue;
+    }
+
+    R_xlen_t n_rows = rows.count_elements();
+    R_xlen_t width = this->declared_width;
+    std::vector<T> values;
+    if (width >= 0) {
+      values.assign(n_rows * width, na_value<T>());
+    }
+
+    R_xlen_t i = 0;
+    for (auto element : rows) {
+      simdjson::ondemand::value row = element.value();
+      simdjson::ondemand::array array;
+      if (row.type() != simdjson::ondemand::json_type::null && safe_get_array(row, path, array)) {
+        R_xlen_t n = array.count_elements();
+        if (width < 0) {
+          width = n;
+          values.assign(n_rows * width, na_value<T>());
+        }
+
+        if (n == width) {
+          parse_number_array<T>(array, n_rows, values.data() + i, path);
+        } else {
+          bad_array_length(row, width, n, path);
+        }
+      }
+      i++;
+    }
+
+    return materialize_matrix(values, n_rows, n_rows, std::max<R_xlen_t>(width, 0));
+  }
+};
+
+
+
+// appends the value of `json` to the native buffer for values of type `T`
+template <typename T>
+inline void append_value(typename Native_Buffer<T>::type& buffer, simdjson::ondemand::value json, JSON_Path& path);
+
+template <>
+inline void append_value<bool>(Column_Buffer<int32_t>& buffer, simdjson::ondemand::value json, JSON_Path& path) {
+  buffer.push_back(parse_scalar_bool(json, path));
+}
+
+template <>
+inline void append_value<int>(Column_Buffer<int32_t>& buffer, simdjson::ondemand::value json, JSON_Path& path) {
+  buffer.push_back(parse_number<int>(json, path));
+}
+
+template <>
+inline void append_value<double>(Column_Buffer<double>& buffer, simdjson::ondemand::value json, JSON_Path& path) {
+  buffer.push_back(parse_number<double>(json, path));
+}
+
+template <>
+inline void append_value<std::string>(String_Buffer& buffer, simdjson::ondemand::value json, JSON_Path& path) {
+  append_scalar_string(buffer, json, path);
+}
+
+// An object used as a dictionary, e.g. `{"sku123": 4, "sku456": 1}`, as a data
+// frame with the columns `key` and `value`. The keys can be anything; all
+// values have type `T`.
+template <typename T>
+class Parser_Map : public virtual Parser {
+protected:
+  String_Buffer keys;
+  typename Native_Buffer<T>::type values;
+
+public:
+  inline SEXP parse_json(simdjson::ondemand::value json, JSON_Path& path) {
+    this->keys.reset(0);
+    this->values.reset(0);
+
+    // `null` and values that aren't objects give an empty map
+    simdjson::ondemand::object object;
+    if (json.type() != simdjson::ondemand::json_type::null && safe_get_object(json, path, object)) {
+      for (auto field : object) {
+        this->keys.push_back(safe_get_key(field));
+        append_value<T>(this->values, field.value(), path);
+      }
+    }
+
+    SEXP out = PROTECT(new_df({"key", "value"}, this->keys.size()));
+    SET_VECTOR_ELT(out, 0, materialize_character(this->keys));
+    SET_VECTOR_ELT(out, 1, materialize_values<T>(this->values, 0, this->values.size()));
+
+    UNPROTECT(1);
+    return out;
+  }
+};
+
 
 
 class Parser_Object : public virtual Parser{
@@ -84,6 +313,8 @@ protected:
   std::unordered_map<std::string_view, bool> key_found;
   std::vector<std::string> field_order;
   std::vector<std::unique_ptr<std::string>> string_view_protection;
+  Column_Stats* stats = nullptr;
+  std::unordered_map<std::string_view, Column_Stats*> field_stats;
 
 public:
   Parser_Object(std::unordered_map<std::string, std::unique_ptr<Parser>>& fields,
@@ -99,6 +330,19 @@ public:
     }
   };
 
+  // `stats` counts the unknown keys
+  inline void set_stats(Column_Stats* stats) {
+    this->stats = stats;
+  }
+
+  // `stats` counts how often the default of `key` is used
+  inline void set_field_stats(const std::string& key, Column_Stats* stats) {
+    auto it = this->fields.find(key);
+    if (it != this->fields.end()) {
+      this->field_stats[(*it).first] = stats;
+    }
+  }
+
   inline SEXP parse_json(simdjson::ondemand::value json, JSON_Path& path) {
     for (auto& it : this->key_found) {
       it.second = false;
@@ -106,26 +350,33 @@ public:
 
     SEXP out = PROTECT(new_named_list(field_order));
 
-    path.insert_dummy<std::string_view>(); // insert dummy so that we can always replace the path
-    simdjson::ondemand::object object = safe_get_object(json, path);
-    for (auto field : object) {
-      std::string_view key = safe_get_key(field);
+    // a value that isn't an object gives the default values
+    simdjson::ondemand::object object;
+    if (safe_get_object(json, path, object)) {
+      for (auto field : object) {
+        std::string_view key = safe_get_key(field);
 
-      auto it = this->fields.find(key);
-      if (it != fields.end()) {
-        path.replace(key);
-        this->key_found[key] = true;
-        int index = name_to_index(this->field_order, key);
-        auto value = (*(*it).second).parse_json(field.value(), path);
-        SET_VECTOR_ELT(out, index, value);
+        auto it = this->fields.find(key);
+        if (it != fields.end()) {
+          this->key_found[key] = true;
+          int index = name_to_index(this->field_order, key);
+          auto value = (*(*it).second).parse_json(field.value(), path);
+          SET_VECTOR_ELT(out, index, value);
+        } else if (this->stats != nullptr) {
+          this->stats->n_unknown_keys++;
+        }
       }
     }
-    path.drop();
 
     for (auto& it : this->key_found) {
       if (!it.second) {
         int index = name_to_index(this->field_order, it.first);
         SET_VECTOR_ELT(out, index, default_values[it.first]);
+
+        auto stats_it = this->field_stats.find(it.first);
+        if (stats_it != this->field_stats.end()) {
+          (*stats_it).second->n_defaults++;
+        }
       }
     }
 
@@ -138,69 +389,309 @@ public:
 
 class Parser_Dataframe : public virtual Parser{
 protected:
+  // the filters of one key; `last_row` is the last row (counted by `n_parsed`)
+  // in which the key passed them
+  struct Key_Filters {
+    std::vector<Row_Filter> filters;
+    int last_row = -1;
+  };
+
   std::unordered_map<std::string_view, std::unique_ptr<Column>> cols;
   std::vector<std::string> col_order;
+  std::unordered_map<std::string_view, Key_Filters> filters;
+  int n_filters = 0;
+  // the number of rows given to `parse_row()`
+  int n_parsed = 0;
+  Row_Sampler sampler;
+  Df_Class df_class;
   std::vector<std::unique_ptr<std::string>> string_view_protection;
   int current_row = 0;
+  Column_Stats* stats = nullptr;
 
 public:
   Parser_Dataframe(std::unordered_map<std::string, std::unique_ptr<Column>>& cols,
-                   const std::vector<std::string> col_order) {
+                   const std::vector<std::string> col_order,
+                   std::vector<std::pair<std::string, Row_Filter>> filters = {},
+                   Row_Sampler sampler = Row_Sampler(),
+                   Df_Class df_class = Df_Class::tibble) {
     for (auto & col : cols) {
       this->string_view_protection.push_back(std::make_unique<std::string>(col.first));
       this->cols.insert({*string_view_protection.back(), std::move(col.second)});
     }
 
+    for (auto & filter : filters) {
+      auto it = this->filters.find(filter.first);
+      if (it == this->filters.end()) {
+        this->string_view_protection.push_back(std::make_unique<std::string>(filter.first));
+        it = this->filters.insert({*string_view_protection.back(), Key_Filters()}).first;
+      }
+      (*it).second.filters.push_back(filter.second);
+      this->n_filters++;
+    }
+
     this->col_order = col_order;
+    this->sampler = sampler;
+    this->df_class = df_class;
   };
 
+  // `stats` counts the unknown keys of the rows
+  inline void set_stats(Column_Stats* stats) {
+    this->stats = stats;
+  }
+
+  // the bytes held by the native buffers of the columns
+  inline int64_t buffer_bytes() {
+    int64_t out = 0;
+    for (auto& col : this->cols) {
+      out += (*col.second).buffer_bytes();
+    }
+    return out;
+  }
+
   inline SEXP parse_json(simdjson::ondemand::value json, JSON_Path& path) {
-    // TODO should `null` be allowed? What should be returned? empty tibble? or `NULL`
-    // TODO should an empty object be allowed?
-    if (json.type() == simdjson::ondemand::json_type::null) {
+    if (!this->parse_rows(json, path)) {
       return R_NilValue;
     }
 
-    simdjson::ondemand::array array = safe_get_array(json, path);
+    return this->finish_rows();
+  }
 
-    int size = array.count_elements();
-    for (auto& col : this->cols) {
-      (*col.second).reserve(size);
+  // like `parse_json()` but the columns are moved into an Arrow struct array;
+  // `dictionary` exports strings dictionary encoded
+  inline void parse_json_arrow(simdjson::ondemand::value json, JSON_Path& path, bool dictionary,
+                               ArrowSchema* schema, ArrowArray* array) {
+    if (!this->parse_rows(json, path)) {
+      this->start_rows(0);
     }
 
+    this->export_arrow_rows("", dictionary, schema, array);
+  }
+
+  // like `finish_rows()` but the columns are moved into an Arrow struct array
+  inline void export_arrow_rows(const std::string& name, bool dictionary, ArrowSchema* schema, ArrowArray* array) {
+    export_arrow_struct(this->current_row, name, this->col_order.size(), schema, array);
+    for (size_t i = 0; i < this->col_order.size(); i++) {
+      const std::string& col_name = this->col_order[i];
+      (*this->cols.find(col_name)->second).export_arrow(col_name, dictionary, schema->children[i], array->children[i]);
+    }
+  }
+
+  // every line of `content` is one row
+  inline SEXP parse_ndjson(const simdjson::padded_string& content,
+                           simdjson::ondemand::parser& parser,
+                           JSON_Path& path) {
+    this->start_rows(count_ndjson_lines(content));
+
+    auto reader = Ndjson_Reader(content);
+    std::string_view line;
     path.insert_dummy<int>();
+    int i = 0;
+    while (!this->sampler.is_done() && reader.next_line(line)) {
+      if (!this->sampler.take_row()) {
+        i++;
+        continue;
+      }
+
+      // the line number is the only part of the path that is tracked
+      path.replace(i++);
+      path.set_document(line);
+      simdjson::ondemand::document doc = parser.iterate(line.data(), line.size(), reader.capacity());
+      simdjson::ondemand::value value = doc;
+      this->add_row(value, path, true);
+    }
+    path.drop();
+
+    return this->finish_rows();
+  }
+
+  // Appends the rows of the array `json` to the rows parsed so far, so that
+  // many arrays end up in one data frame. Call `start_rows()` once before and
+  // `finish_rows()` once after. The sampler applies to each array on its own.
+  // Returns the number of rows kept or -1 if `json` is `null` or no array.
+  inline int append_rows(simdjson::ondemand::value json, JSON_Path& path) {
+    simdjson::ondemand::array array;
+    if (json.type() == simdjson::ondemand::json_type::null || !safe_get_array(json, path, array)) {
+      return -1;
+    }
+
+    int n_before = this->current_row;
+    this->sampler.start(array.count_elements());
+    for (auto element : array) {
+      if (this->sampler.is_done()) break;
+      if (!this->sampler.take_row()) continue;
+
+      this->add_row(element.value(), path);
+    }
+
+    return this->current_row - n_before;
+  }
+
+  // `n_rows` is only a hint if rows are appended
+  inline void start_rows(int n_rows) {
+    int size = this->sampler.start(n_rows);
+    for (auto& col : this->cols) {
+      (*col.second).reserve(size);
+    }
     this->current_row = 0;
+  }
+
+  inline SEXP finish_rows() {
+    for (auto& col : this->cols) {
+      if ((*col.second).get_parent_rows() != nullptr) {
+        return this->finish_unnested_rows(col.first, *col.second);
+      }
+    }
+
+    SEXP out = PROTECT(new_df(this->col_order, this->current_row, this->df_class));
+    for (auto& col : this->cols) {
+      int index = name_to_index(this->col_order, col.first);
+      SET_VECTOR_ELT(out, index, (*col.second).get_value());
+    }
+
+    UNPROTECT(1);
+    return out;
+  }
+
+protected:
+  // `false` if `json` is `null` or a recorded problem, i.e. there are no rows
+  inline bool parse_rows(simdjson::ondemand::value json, JSON_Path& path) {
+    // TODO should `null` be allowed? What should be returned? empty tibble? or `NULL`
+    // TODO should an empty object be allowed?
+    if (json.type() == simdjson::ondemand::json_type::null) {
+      return false;
+    }
+
+    // only the rows of the top-level data frame are recorded for problems
+    bool top_level = path.is_document_root(json.raw_json_token().data());
+    simdjson::ondemand::array array;
+    if (!safe_get_array(json, path, array)) {
+      return false;
+    }
+
+    this->start_rows(array.count_elements());
+
     for (auto element : array) {
-      path.replace(this->current_row);
+      if (this->sampler.is_done()) break;
+      if (!this->sampler.take_row()) continue;
+
       // TODO allow null instead of object?
-      simdjson::ondemand::object object = safe_get_object(element.value(), path);
+      this->add_row(element.value(), path, top_level);
+    }
 
-      path.insert_dummy<std::string_view>();
-      for (auto field : object) {
-        std::string_view key = safe_get_key(field);
+    return true;
+  }
 
-        auto it = this->cols.find(key);
-        if (it != cols.end()) {
-          path.replace(key);
-          (*(*it).second).add_value(field.value(), path);
-        }
-      }
-      path.drop();
+  // a value that isn't an object (only possible if problems are collected)
+  // becomes a row of default values; `top_level` records the row of problems
+  inline void add_row(simdjson::ondemand::value value, JSON_Path& path, bool top_level = false) {
+    Problems* problems = top_level ? path.get_problems() : nullptr;
+    int n_problems = 0;
+    if (problems != nullptr) {
+      n_problems = problems->size();
+      problems->set_row(this->current_row + 1);
+    }
+
+    simdjson::ondemand::object object;
+    bool keep_row;
+    if (safe_get_object(value, path, object)) {
+      keep_row = this->parse_row(object, path);
+    } else {
+      keep_row = this->n_filters == 0;
+    }
 
+    if (keep_row) {
       for (auto& col : this->cols) {
         (*col.second).finalize_row();
       }
       this->current_row++;
+      this->sampler.keep_row();
+    } else {
+      for (auto& col : this->cols) {
+        (*col.second).discard_row();
+      }
+      if (problems != nullptr) {
+        problems->unset_rows(n_problems);
+      }
     }
-    path.drop();
 
-    SEXP out = PROTECT(new_df(this->col_order, size));
-    for (auto& col : this->cols) {
-      int index = name_to_index(this->col_order, col.first);
-      SET_VECTOR_ELT(out, index, (*col.second).get_value());
+    if (problems != nullptr) {
+      problems->set_row(NA_INTEGER);
     }
+  }
 
-    UNPROTECT(1);
+  // The data frame in long format: the columns of `unnested` (a data frame
+  // with one row per nested row) take its place and the other columns are
+  // repeated for each of their rows. Rows without nested rows are dropped.
+  inline SEXP finish_unnested_rows(std::string_view unnested_name, Column& unnested) {
+    SEXP nested = PROTECT(unnested.get_value());
+    const std::vector<int>& parent_rows = *unnested.get_parent_rows();
+    SEXP nested_names = Rf_getAttrib(nested, R_NamesSymbol);
+
+    std::vector<std::string> out_names;
+    for (const std::string& name : this->col_order) {
+      if (name == unnested_name) {
+        for (R_xlen_t j = 0; j < Rf_xlength(nested); j++) {
+          out_names.push_back(Rf_translateCharUTF8(STRING_ELT(nested_names, j)));
+        }
+      } else {
+        out_names.push_back(name);
+      }
+    }
+
+    SEXP out = PROTECT(new_df(out_names, parent_rows.size(), this->df_class));
+    int index = 0;
+    for (const std::string& name : this->col_order) {
+      if (name == unnested_name) {
+        for (R_xlen_t j = 0; j < Rf_xlength(nested); j++) {
+          SET_VECTOR_ELT(out, index++, VECTOR_ELT(nested, j));
+        }
+      } else {
+        SEXP x = PROTECT((*this->cols.find(name)->second).get_value());
+        SET_VECTOR_ELT(out, index++, slice_rows(x, parent_rows));
+        UNPROTECT(1);
+      }
+    }
+
+    UNPROTECT(2);
     return out;
   }
+
+  // returns `false` if the row is rejected by a filter; the remaining fields of
+  // a rejected row are not looked at. A key that appears twice must pass its
+  // filters both times but counts once.
+  inline bool parse_row(simdjson::ondemand::object object, JSON_Path& path) {
+    int n_passed = 0;
+    int row = this->n_parsed++;
+
+    for (auto field : object) {
+      std::string_view key = safe_get_key(field);
+      simdjson::ondemand::value value = field.value();
+
+      if (this->n_filters > 0) {
+        auto filter_it = this->filters.find(key);
+        if (filter_it != this->filters.end()) {
+          Key_Filters& key_filters = (*filter_it).second;
+          for (auto& filter : key_filters.filters) {
+            if (!filter.matches(value)) {
+              return false;
+            }
+          }
+          if (key_filters.last_row != row) {
+            key_filters.last_row = row;
+            n_passed += key_filters.filters.size();
+          }
+        }
+      }
+
+      auto it = this->cols.find(key);
+      if (it != cols.end()) {
+        (*(*it).second).add_value(value, path);
+      } else if (this->stats != nullptr && this->filters.find(key) == this->filters.end()) {
+        this->stats->n_unknown_keys++;
+      }
+    }
+
+    // a missing filter field also rejects the row
+    return n_passed == this->n_filters;
+  }
 };
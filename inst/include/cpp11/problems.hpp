@@ -0,0 +1,105 @@
+#pragma once
+
+#define STRICT_R_HEADERS
+#include "cpp11.hpp"
+#include "utils.hpp"
+
+#include <string>
+#include <vector>
+
+// what happens with values that cannot be parsed
+enum class Error_Mode {stop, na, collect};
+
+inline Error_Mode parse_error_mode(const std::string& on_error) {
+  if (on_error == "stop") return Error_Mode::stop;
+  if (on_error == "na") return Error_Mode::na;
+  if (on_error == "collect") return Error_Mode::collect;
+
+  cpp11::stop("`on_error` must be one of \"stop\", \"na\" or \"collect\".");
+}
+
+// Values that could not be parsed and were replaced by a missing value.
+// Nothing is recorded unless the mode is `collect`.
+class Problems {
+private:
+  Error_Mode mode;
+  int row = NA_INTEGER;
+  std::vector<int> rows;
+  std::vector<std::string> paths;
+  std::vector<std::string> expected;
+  std::vector<std::string> actual;
+
+public:
+  Problems(Error_Mode mode) {
+    this->mode = mode;
+  }
+
+  inline Error_Mode get_mode() const {
+    return this->mode;
+  }
+
+  // the row (1-based) of the resulting data frame that problems belong to
+  inline void set_row(int row) {
+    this->row = row;
+  }
+
+  // the problems from the `from`-th on belong to no row, e.g. as their row was
+  // rejected by a filter
+  inline void unset_rows(int from) {
+    for (size_t i = from; i < this->rows.size(); i++) {
+      this->rows[i] = NA_INTEGER;
+    }
+  }
+
+  inline void add(std::string path, std::string expected, std::string actual) {
+    if (this->mode != Error_Mode::collect) {
+      return;
+    }
+
+    this->rows.push_back(this->row);
+    this->paths.push_back(std::move(path));
+    this->expected.push_back(std::move(expected));
+    this->actual.push_back(std::move(actual));
+  }
+
+  inline int size() const {
+    return this->paths.size();
+  }
+
+  // a tibble with the columns `row`, `path`, `expected` and `actual`, where
+  // `row` is the row of the resulting data frame if there is one
+  inline SEXP get_value() const {
+    int n = this->size();
+    SEXP out = PROTECT(new_df({"row", "path", "expected", "actual"}, n));
+
+    SEXP row = Rf_allocVector(INTSXP, n);
+    SET_VECTOR_ELT(out, 0, row);
+    SEXP path = Rf_allocVector(STRSXP, n);
+    SET_VECTOR_ELT(out, 1, path);
+    SEXP expected = Rf_allocVector(STRSXP, n);
+    SET_VECTOR_ELT(out, 2, expected);
+    SEXP actual = Rf_allocVector(STRSXP, n);
+    SET_VECTOR_ELT(out, 3, actual);
+
+    for (int i = 0; i < n; i++) {
+      INTEGER(row)[i] = this->rows[i];
+      SET_STRING_ELT(path, i, mk_utf8_char(this->paths[i]));
+      SET_STRING_ELT(expected, i, mk_utf8_char(this->expected[i]));
+      SET_STRING_ELT(actual, i, mk_utf8_char(this->actual[i]));
+    }
+
+    UNPROTECT(1);
+    return out;
+  }
+
+  // in mode `collect` the problems become the attribute `problems` of `x`
+  inline void attach_to(SEXP x) const {
+    if (this->mode != Error_Mode::collect || x == R_NilValue) {
+      return;
+    }
+
+    SEXP value = PROTECT(this->get_value());
+    Rf_setAttrib(x, Rf_install("problems"), value);
+    UNPROTECT(1);
+  }
+};
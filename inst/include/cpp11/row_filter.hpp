@@ -0,0 +1,95 @@
+#pragma once
+
+#define STRICT_R_HEADERS
+#include "cpp11.hpp"
+#include "json_utils.hpp"
+
+#include <string>
+
+enum class Filter_Op {eq, ne, lt, le, gt, ge};
+
+inline Filter_Op parse_filter_op(const std::string& op) {
+  if (op == "==") return Filter_Op::eq;
+  if (op == "!=") return Filter_Op::ne;
+  if (op == "<") return Filter_Op::lt;
+  if (op == "<=") return Filter_Op::le;
+  if (op == ">") return Filter_Op::gt;
+  if (op == ">=") return Filter_Op::ge;
+
+  cpp11::stop("Unsupported filter operator `%s`.", op.c_str());
+}
+
+// Compares the value of one field of a row against a string or a number.
+// Rows where the field is `null`, missing or of another type are rejected.
+// Strings are compared bytewise, i.e. like in the C locale.
+class Row_Filter {
+private:
+  Filter_Op op;
+  bool is_string;
+  std::string string_val;
+  double double_val = 0;
+
+  template <typename T>
+  inline bool compare(const T& x, const T& y) const {
+    switch (this->op) {
+    case Filter_Op::eq:
+      return x == y;
+      break;
+    case Filter_Op::ne:
+      return x != y;
+      break;
+    case Filter_Op::lt:
+      return x < y;
+      break;
+    case Filter_Op::le:
+      return x <= y;
+      break;
+    case Filter_Op::gt:
+      return x > y;
+      break;
+    case Filter_Op::ge:
+      return x >= y;
+      break;
+    }
+
+    return false;
+  }
+
+public:
+  Row_Filter(const std::string& op, const std::string& value) {
+    this->op = parse_filter_op(op);
+    this->is_string = true;
+    this->string_val = value;
+  }
+
+  Row_Filter(const std::string& op, double value) {
+    this->op = parse_filter_op(op);
+    this->is_string = false;
+    this->double_val = value;
+  }
+
+  // Scalars can be read again afterwards, so `json` can still be passed on to
+  // a column.
+  inline bool matches(simdjson::ondemand::value json) const {
+    using simdjson::ondemand::json_type;
+
+    switch (json.type()) {
+    case json_type::string: {
+      if (!this->is_string) return false;
+      // usually avoids unescaping the string twice
+      return this->compare(string_content(json), std::string_view(this->string_val));
+      break;
+    }
+    case json_type::number:
+      if (this->is_string) return false;
+      return this->compare(double(json), this->double_val);
+      break;
+    case json_type::boolean:
+      if (this->is_string) return false;
+      return this->compare(bool(json) ? 1.0 : 0.0, this->double_val);
+      break;
+    default:
+      return false;
+    }
+  }
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#define STRICT_R_HEADERS
+#include "cpp11.hpp"
+#include "cpp11/R.hpp"
+
+#include <R_ext/Random.h>
+
+#include <algorithm>
+
+// R's RNG state is loaded at most once per parse, by the first sampler that
+// draws, and shared by all samplers after it. Reloading `.Random.seed` in a
+// nested sampler would replay the draws of the outer sampler.
+class Rng_State {
+public:
+  // Owns the RNG state while it is alive and gives it back to R at the end,
+  // also if a parse stopped with an error. The entry points hold one while they
+  // parse; a nested `Scope` uses the state of the outermost one.
+  class Scope {
+  private:
+    bool loaded = false;
+
+  public:
+    Scope() {
+      if (active == nullptr) active = this;
+    }
+
+    ~Scope() {
+      if (active != this) return;
+
+      active = nullptr;
+      if (this->loaded) PutRNGstate();
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    friend class Rng_State;
+  };
+
+  // loads the RNG state unless it is loaded already; needs an active `Scope`
+  static void acquire() {
+    if (active == nullptr) {
+      cpp11::stop("Internal error: the RNG is used outside of an `Rng_State::Scope`.");
+    }
+
+    if (!active->loaded) {
+      GetRNGstate();
+      active->loaded = true;
+    }
+  }
+
+private:
+  inline static Scope* active = nullptr;
+};
+
+// Decides which rows of a data frame are parsed at all:
+// * the first `skip` rows are dropped,
+// * of the remaining rows each one is kept with probability `sample_fraction`
+//   or exactly `sample_size` rows are drawn uniformly. As the number of rows is
+//   known up front this uses selection sampling (Knuth's algorithm S) and never
+//   has to replace an already parsed row,
+// * parsing stops once `n_max` rows were kept.
+// Rows that are not taken are never looked at, so simdjson only skips over them.
+class Row_Sampler {
+private:
+  int skip = 0;
+  int n_max = -1;
+  double sample_fraction = 1;
+  int sample_size = -1;
+
+  int n_candidates = 0;
+  int n_seen = 0;
+  int n_selected = 0;
+  int n_kept = 0;
+
+public:
+  Row_Sampler() {}
+
+  Row_Sampler(int skip, int n_max, double sample_fraction, int sample_size) {
+    this->skip = skip;
+    this->n_max = n_max;
+    this->sample_fraction = sample_fraction;
+    this->sample_size = sample_size;
+  }
+
+  // `n_rows` is the number of available rows; returns an upper bound for the
+  // number of rows that will be kept. Can be called again to sample another
+  // set of rows.
+  inline int start(int n_rows) {
+    this->n_candidates = std::max(n_rows - this->skip, 0);
+    this->n_seen = 0;
+    this->n_selected = 0;
+    this->n_kept = 0;
+
+    int n = this->n_candidates;
+    bool uses_rng = this->sample_fraction < 1;
+    if (this->sample_size >= 0 && this->sample_size < n) {
+      n = this->sample_size;
+      uses_rng = true;
+    }
+    if (this->n_max >= 0 && this->n_max < n) {
+      n = this->n_max;
+    }
+
+    if (uses_rng) Rng_State::acquire();
+    return n;
+  }
+
+  // `true` once no further row can be kept
+  inline bool is_done() const {
+    return (this->n_max >= 0 && this->n_kept >= this->n_max) ||
+      (this->sample_size >= 0 && this->n_selected >= this->sample_size);
+  }
+
+  // decides whether the next row is parsed
+  inline bool take_row() {
+    int i = this->n_seen++;
+    if (i < this->skip) {
+      return false;
+    }
+
+    if (this->sample_size >= 0) {
+      int n_left = this->n_candidates - (i - this->skip);
+      int n_needed = this->sample_size - this->n_selected;
+      if (n_needed < n_left && n_left * unif_rand() >= n_needed) {
+        return false;
+      }
+    } else if (this->sample_fraction < 1 && unif_rand() >= this->sample_fraction) {
+      return false;
+    }
+
+    this->n_selected++;
+    return true;
+  }
+
+  // a taken row was actually kept, i.e. it wasn't rejected by a filter
+  inline void keep_row() {
+    this->n_kept++;
+  }
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#define STRICT_R_HEADERS
+#include "cpp11.hpp"
+#include "cpp11/R.hpp"
+#include "cpp11/simdjson.h"
+#include "utils.hpp"
+
+#include <string>
+
+// simdjson picks the kernel for the CPU at runtime (e.g. "icelake" with
+// AVX-512, "haswell", "westmere" or "fallback"). A parser uses the kernel that
+// is active when it allocates its buffers, i.e. at the start of a parse.
+
+// Until the first parse the active kernel is only a placeholder that detects
+// the best one (honouring the env var `SIMDJSON_FORCE_IMPLEMENTATION`).
+// Allocating a parser runs the detection.
+inline const simdjson::implementation* detect_simdjson_kernel() {
+  const simdjson::implementation* impl = simdjson::active_implementation;
+  if (simdjson::available_implementations[impl->name()] == nullptr) {
+    simdjson::ondemand::parser parser;
+    (void) parser.allocate(simdjson::SIMDJSON_PADDING);
+    impl = simdjson::active_implementation;
+  }
+  return impl;
+}
+
+// a data frame of the kernels compiled into the package
+inline SEXP simdjson_kernels() {
+  int n = 0;
+  for (auto impl : simdjson::available_implementations) {
+    (void) impl;
+    n++;
+  }
+
+  SEXP out = PROTECT(new_df({"name", "description", "supported", "active"}, n));
+  SEXP name = Rf_allocVector(STRSXP, n);
+  SET_VECTOR_ELT(out, 0, name);
+  SEXP description = Rf_allocVector(STRSXP, n);
+  SET_VECTOR_ELT(out, 1, description);
+  SEXP supported = Rf_allocVector(LGLSXP, n);
+  SET_VECTOR_ELT(out, 2, supported);
+  SEXP active = Rf_allocVector(LGLSXP, n);
+  SET_VECTOR_ELT(out, 3, active);
+
+  const simdjson::implementation* active_impl = detect_simdjson_kernel();
+  int i = 0;
+  for (auto impl : simdjson::available_implementations) {
+    SET_STRING_ELT(name, i, Rf_mkCharCE(impl->name().c_str(), CE_UTF8));
+    SET_STRING_ELT(description, i, Rf_mkCharCE(impl->description().c_str(), CE_UTF8));
+    LOGICAL(supported)[i] = impl->supported_by_runtime_system();
+    LOGICAL(active)[i] = impl->name() == active_impl->name();
+    i++;
+  }
+
+  UNPROTECT(1);
+  return out;
+}
+
+inline std::string active_simdjson_kernel() {
+  return detect_simdjson_kernel()->name();
+}
+
+// Makes `name` the kernel of all following parses and returns the previous
+// one. Fails if the kernel isn't compiled in or the CPU doesn't support it.
+inline std::string set_simdjson_kernel(const std::string& name) {
+  const simdjson::implementation* impl = simdjson::available_implementations[name];
+  if (impl == nullptr) {
+    cpp11::stop("simdjson kernel `%s` is not available.", name.c_str());
+  }
+  if (!impl->supported_by_runtime_system()) {
+    cpp11::stop("simdjson kernel `%s` is not supported by this CPU.", name.c_str());
+  }
+
+  std::string previous = active_simdjson_kernel();
+  simdjson::active_implementation = impl;
+  return previous;
+}
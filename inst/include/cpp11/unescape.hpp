@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// reads the four hex digits of `\uXXXX` starting at `pos`
+inline bool parse_hex4(std::string_view raw, size_t pos, uint32_t& out) {
+  if (pos + 4 > raw.size()) {
+    return false;
+  }
+
+  out = 0;
+  for (size_t i = pos; i < pos + 4; i++) {
+    char c = raw[i];
+    out <<= 4;
+    if (c >= '0' && c <= '9') {
+      out |= c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      out |= c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      out |= c - 'A' + 10;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+inline void append_utf8(uint32_t code_point, std::string& out) {
+  if (code_point < 0x80) {
+    out.push_back(static_cast<char>(code_point));
+  } else if (code_point < 0x800) {
+    out.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+    out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else if (code_point < 0x10000) {
+    out.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+    out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else {
+    out.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+    out.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  }
+}
+
+// Appends the JSON string content `raw` (the bytes between the quotes) unescaped
+// to `out`, so that it is copied only once. `false` for an invalid escape
+// sequence or a lone surrogate, which are left to simdjson to report, and for
+// `\u0000` as R strings cannot contain NUL; `out` may then have a partial
+// value.
+inline bool append_unescaped(std::string_view raw, std::string& out) {
+  size_t i = 0;
+  while (i < raw.size()) {
+    size_t escape = raw.find('\\', i);
+    if (escape == std::string_view::npos) {
+      out.append(raw.data() + i, raw.size() - i);
+      return true;
+    }
+
+    out.append(raw.data() + i, escape - i);
+    if (escape + 1 >= raw.size()) {
+      return false;
+    }
+    i = escape + 2;
+    switch (raw[escape + 1]) {
+    case '"': out.push_back('"'); break;
+    case '\\': out.push_back('\\'); break;
+    case '/': out.push_back('/'); break;
+    case 'b': out.push_back('\b'); break;
+    case 'f': out.push_back('\f'); break;
+    case 'n': out.push_back('\n'); break;
+    case 'r': out.push_back('\r'); break;
+    case 't': out.push_back('\t'); break;
+    case 'u': {
+      uint32_t code_point;
+      if (!parse_hex4(raw, i, code_point)) {
+        return false;
+      }
+      i += 4;
+
+      if (code_point >= 0xD800 && code_point < 0xDC00) {
+        // a high surrogate must be followed by a low one
+        uint32_t low;
+        if (i + 1 >= raw.size() || raw[i] != '\\' || raw[i + 1] != 'u' ||
+            !parse_hex4(raw, i + 2, low) || low < 0xDC00 || low >= 0xE000) {
+          return false;
+        }
+        i += 6;
+        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+      } else if ((code_point >= 0xDC00 && code_point < 0xE000) || code_point == 0) {
+        return false;
+      }
+      append_utf8(code_point, out);
+      break;
+    }
+    default:
+      return false;
+    }
+  }
+
+  return true;
+}
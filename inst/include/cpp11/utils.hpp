@@ -4,8 +4,18 @@
 #include "cpp11.hpp"
 #include "cpp11/R.hpp"
 
+#include <algorithm>
+#include <string_view>
 #include <vector>
 
+// An R string of the UTF-8 bytes `x`. It is created from the length, so `x`
+// doesn't need to be NUL terminated, and marked as UTF-8 so that R doesn't
+// re-encode it later. `x` must not contain NUL, which R rejects with an error;
+// parsed strings are checked while unescaping, see `bad_nul_string()`.
+inline SEXP mk_utf8_char(std::string_view x) {
+    return Rf_mkCharLenCE(x.data(), x.size(), CE_UTF8);
+}
+
 inline SEXP new_named_list(std::vector<std::string> nms) {
     int n_fields = nms.size();
     SEXP out = PROTECT(Rf_allocVector(VECSXP, n_fields));
@@ -13,7 +23,7 @@ inline SEXP new_named_list(std::vector<std::string> nms) {
     SEXP nms_sexp = PROTECT(Rf_allocVector(STRSXP, n_fields));
     int i = 0;
     for (auto nm : nms) {
-        SET_STRING_ELT(nms_sexp, i, Rf_mkChar(nm.c_str()));
+        SET_STRING_ELT(nms_sexp, i, mk_utf8_char(nm));
         i++;
     }
     Rf_setAttrib(out, Rf_install("names"), nms_sexp);
@@ -23,8 +33,20 @@ inline SEXP new_named_list(std::vector<std::string> nms) {
     return out;
 }
 
-inline SEXP new_df(std::vector<std::string> col_nms, int n_rows) {
-    SEXP out = new_named_list(col_nms);
+// the class of the data frames that are created
+enum class Df_Class {tibble, data_frame, data_table};
+
+inline Df_Class parse_df_class(const std::string& as) {
+    if (as == "tibble") return Df_Class::tibble;
+    if (as == "data.frame") return Df_Class::data_frame;
+    if (as == "data.table") return Df_Class::data_table;
+
+    cpp11::stop("`as` must be one of \"tibble\", \"data.frame\" or \"data.table\".");
+}
+
+// A data.table is only a data frame with its class; see `alloc_data_table()`.
+inline SEXP new_df(std::vector<std::string> col_nms, int n_rows, Df_Class df_class = Df_Class::tibble) {
+    SEXP out = PROTECT(new_named_list(col_nms));
 
     // add row.names attribute
     SEXP row_attr = PROTECT(Rf_allocVector(INTSXP, 2));
@@ -34,13 +56,155 @@ inline SEXP new_df(std::vector<std::string> col_nms, int n_rows) {
     UNPROTECT(1);
 
     // add class
-    SEXP class_attr = PROTECT(Rf_allocVector(STRSXP, 3));
-    SET_STRING_ELT(class_attr, 0, Rf_mkChar("tbl_df"));
-    SET_STRING_ELT(class_attr, 1, Rf_mkChar("tbl"));
-    SET_STRING_ELT(class_attr, 2, Rf_mkChar("data.frame"));
-    Rf_setAttrib(out, Rf_install("class"), class_attr);
+    if (df_class == Df_Class::data_frame) {
+        SEXP class_attr = PROTECT(Rf_mkString("data.frame"));
+        Rf_setAttrib(out, R_ClassSymbol, class_attr);
+        UNPROTECT(1);
+    } else if (df_class == Df_Class::data_table) {
+        SEXP class_attr = PROTECT(Rf_allocVector(STRSXP, 2));
+        SET_STRING_ELT(class_attr, 0, Rf_mkChar("data.table"));
+        SET_STRING_ELT(class_attr, 1, Rf_mkChar("data.frame"));
+        Rf_setAttrib(out, Rf_install("class"), class_attr);
+        UNPROTECT(1);
+    } else {
+        SEXP class_attr = PROTECT(Rf_allocVector(STRSXP, 3));
+        SET_STRING_ELT(class_attr, 0, Rf_mkChar("tbl_df"));
+        SET_STRING_ELT(class_attr, 1, Rf_mkChar("tbl"));
+        SET_STRING_ELT(class_attr, 2, Rf_mkChar("data.frame"));
+        Rf_setAttrib(out, Rf_install("class"), class_attr);
+        UNPROTECT(1);
+    }
+
+    UNPROTECT(1);
+    return out;
+}
+
+// data.table only adds columns by reference to a table with spare column
+// slots, so a data.table that is returned to R goes through
+// `data.table::setalloccol()` like `setDT()` would do. This is only done for
+// the result itself: nested data.tables, e.g. in a `df_vec` column, keep their
+// exact size, and `setDT()` must be called on them before adding columns.
+//
+// `x` must be protected by the caller.
+inline SEXP alloc_data_table(SEXP x) {
+    if (!Rf_inherits(x, "data.table")) {
+        return x;
+    }
+
+    // `cpp11::package()` only finds namespaces that are already loaded
+    auto require_namespace = cpp11::package("base")["requireNamespace"];
+    bool installed = cpp11::as_cpp<bool>(
+        require_namespace("data.table", cpp11::named_arg("quietly") = true)
+    );
+    if (!installed) {
+        cpp11::stop("The package data.table is required for `as = \"data.table\"`.");
+    }
+
+    return cpp11::package("data.table")["setalloccol"](x);
+}
+
+inline void set_datetime_class(SEXP x) {
+    SEXP class_attr = PROTECT(Rf_allocVector(STRSXP, 2));
+    SET_STRING_ELT(class_attr, 0, Rf_mkChar("POSIXct"));
+    SET_STRING_ELT(class_attr, 1, Rf_mkChar("POSIXt"));
+    Rf_setAttrib(x, Rf_install("class"), class_attr);
+    UNPROTECT(1);
+
+    SEXP tzone = PROTECT(Rf_mkString("UTC"));
+    Rf_setAttrib(x, Rf_install("tzone"), tzone);
+    UNPROTECT(1);
+}
+
+inline void set_date_class(SEXP x) {
+    SEXP class_attr = PROTECT(Rf_mkString("Date"));
+    Rf_setAttrib(x, R_ClassSymbol, class_attr);
     UNPROTECT(1);
+}
+
+// a double vector holding the bits of 64 bit integers, as used by bit64
+inline void set_integer64_class(SEXP x) {
+    SEXP class_attr = PROTECT(Rf_mkString("integer64"));
+    Rf_setAttrib(x, R_ClassSymbol, class_attr);
+    UNPROTECT(1);
+}
+
+// keeps only the first `n` elements of `x`; returns `x` itself if nothing is dropped
+inline SEXP shrink_vector(SEXP x, R_xlen_t n) {
+    if (Rf_xlength(x) == n) {
+        return x;
+    }
+
+    return Rf_xlengthgets(x, n);
+}
+
+// `x` with room for at least `n` elements, for columns that get more rows than
+// they reserved; returns `x` itself if it is already large enough
+inline SEXP grow_vector(SEXP x, R_xlen_t n) {
+    R_xlen_t size = Rf_xlength(x);
+    if (n <= size) {
+        return x;
+    }
+
+    return Rf_xlengthgets(x, std::max(n, 2 * size));
+}
 
+// The rows `index` (0-based, may repeat) of a column, i.e. of a vector, a
+// matrix or a data frame. Attributes like the class are kept.
+inline SEXP slice_rows(SEXP x, const std::vector<int>& index) {
+    R_xlen_t n = index.size();
+
+    if (Rf_inherits(x, "data.frame")) {
+        R_xlen_t n_cols = Rf_xlength(x);
+        SEXP out = PROTECT(Rf_allocVector(VECSXP, n_cols));
+        Rf_copyMostAttrib(x, out);
+        Rf_setAttrib(out, R_NamesSymbol, Rf_getAttrib(x, R_NamesSymbol));
+        for (R_xlen_t j = 0; j < n_cols; j++) {
+            SET_VECTOR_ELT(out, j, slice_rows(VECTOR_ELT(x, j), index));
+        }
+
+        SEXP row_attr = PROTECT(Rf_allocVector(INTSXP, 2));
+        SET_INTEGER_ELT(row_attr, 0, NA_INTEGER);
+        SET_INTEGER_ELT(row_attr, 1, -n);
+        Rf_setAttrib(out, Rf_install("row.names"), row_attr);
+
+        UNPROTECT(2);
+        return out;
+    }
+
+    SEXP dim = Rf_getAttrib(x, R_DimSymbol);
+    R_xlen_t n_rows = Rf_isNull(dim) ? Rf_xlength(x) : INTEGER(dim)[0];
+    R_xlen_t width = Rf_isNull(dim) ? 1 : INTEGER(dim)[1];
+
+    SEXP out = PROTECT(Rf_isNull(dim) ? Rf_allocVector(TYPEOF(x), n) : Rf_allocMatrix(TYPEOF(x), n, width));
+    for (R_xlen_t j = 0; j < width; j++) {
+        R_xlen_t from = j * n_rows;
+        R_xlen_t to = j * n;
+        for (R_xlen_t i = 0; i < n; i++) {
+            R_xlen_t k = from + index[i];
+            switch (TYPEOF(x)) {
+            case LGLSXP:
+                LOGICAL(out)[to + i] = LOGICAL(x)[k];
+                break;
+            case INTSXP:
+                INTEGER(out)[to + i] = INTEGER(x)[k];
+                break;
+            case REALSXP:
+                REAL(out)[to + i] = REAL(x)[k];
+                break;
+            case STRSXP:
+                SET_STRING_ELT(out, to + i, STRING_ELT(x, k));
+                break;
+            case VECSXP:
+                SET_VECTOR_ELT(out, to + i, VECTOR_ELT(x, k));
+                break;
+            default:
+                cpp11::stop("slice_rows(): unsupported type");
+            }
+        }
+    }
+    Rf_copyMostAttrib(x, out);
+
+    UNPROTECT(1);
     return out;
 }
 
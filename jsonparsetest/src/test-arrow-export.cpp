@@ -0,0 +1,118 @@
+// All test files should include the <testthat.h>
+// header file.
+#include <cpp11/column_class.hpp>
+#include <testthat.h>
+
+context("Parser_Dataframe to Arrow") {
+  using namespace simdjson;
+  using namespace cpp11;
+
+  auto json = R"(  [
+    {"int": 1, "str": "a", "int_vec": [1, 2]},
+    {"int": null, "str": "b"},
+    {"int": 3, "str": "a", "int_vec": [3]}
+  ]  )"_padded;
+
+  std::vector<std::string> col_order = std::vector<std::string>({"int", "str", "int_vec"});
+  auto path = JSON_Path();
+  ondemand::parser parser;
+
+  test_that("exports a struct array") {
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["int"] = std::make_unique<Column_Scalar<int>>(-1);
+    cols["str"] = std::make_unique<Column_Scalar<std::string>>("z");
+    cols["int_vec"] = std::make_unique<Column_Vector<int>>(R_NilValue);
+    auto parser_df = Parser_Dataframe(cols, col_order);
+
+    auto doc = parser.iterate(json);
+    simdjson::ondemand::value value = doc;
+    ArrowSchema schema{};
+    ArrowArray array{};
+    parser_df.parse_json_arrow(value, path, false, &schema, &array);
+
+    expect_true(std::string(schema.format) == "+s");
+    expect_true(array.length == 3);
+    expect_true(array.n_children == 3);
+
+    expect_true(std::string(schema.children[0]->format) == "i");
+    expect_true(array.children[0]->null_count == 1);
+    const int32_t* ints = static_cast<const int32_t*>(array.children[0]->buffers[1]);
+    expect_true(ints[0] == 1);
+    expect_true(ints[2] == 3);
+
+    expect_true(std::string(schema.children[1]->format) == "U");
+    const int64_t* offsets = static_cast<const int64_t*>(array.children[1]->buffers[1]);
+    expect_true(offsets[3] == 3);
+
+    expect_true(std::string(schema.children[2]->format) == "+L");
+    expect_true(array.children[2]->null_count == 1);
+    expect_true(array.children[2]->children[0]->length == 3);
+
+    schema.release(&schema);
+    array.release(&array);
+    expect_true(schema.release == nullptr);
+    expect_true(array.release == nullptr);
+  }
+
+  test_that("can export strings dictionary encoded") {
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["str"] = std::make_unique<Column_Scalar<std::string>>("z");
+    auto parser_df = Parser_Dataframe(cols, {"str"});
+
+    auto doc = parser.iterate(json);
+    simdjson::ondemand::value value = doc;
+    ArrowSchema schema{};
+    ArrowArray array{};
+    parser_df.parse_json_arrow(value, path, true, &schema, &array);
+
+    expect_true(std::string(schema.children[0]->format) == "i");
+    expect_true(std::string(schema.children[0]->dictionary->format) == "U");
+    expect_true(array.children[0]->dictionary->length == 2);
+    const int32_t* indices = static_cast<const int32_t*>(array.children[0]->buffers[1]);
+    expect_true(indices[0] == 0);
+    expect_true(indices[1] == 1);
+    expect_true(indices[2] == 0);
+
+    schema.release(&schema);
+    array.release(&array);
+  }
+
+  test_that("exports a list of data frames as a large list of structs") {
+    auto json_df = R"(  [
+      {"df": [{"a": 1}, {"a": 2}]},
+      {"df": null},
+      {"df": [{"a": 3}]}
+    ]  )"_padded;
+
+    std::unordered_map<std::string, std::unique_ptr<Column>> nested_cols;
+    nested_cols["a"] = std::make_unique<Column_Scalar<int>>(-1);
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["df"] = std::make_unique<Column_ListOfDf>(nested_cols, std::vector<std::string>({"a"}));
+    auto parser_df = Parser_Dataframe(cols, {"df"});
+
+    auto doc = parser.iterate(json_df);
+    simdjson::ondemand::value value = doc;
+    ArrowSchema schema{};
+    ArrowArray array{};
+    parser_df.parse_json_arrow(value, path, false, &schema, &array);
+
+    ArrowSchema* df_schema = schema.children[0];
+    ArrowArray* df_array = array.children[0];
+    expect_true(std::string(df_schema->format) == "+L");
+    expect_true(df_array->length == 3);
+    expect_true(df_array->null_count == 1);
+    const int64_t* offsets = static_cast<const int64_t*>(df_array->buffers[1]);
+    expect_true(offsets[0] == 0);
+    expect_true(offsets[1] == 2);
+    expect_true(offsets[2] == 2);
+    expect_true(offsets[3] == 3);
+
+    expect_true(std::string(df_schema->children[0]->format) == "+s");
+    expect_true(df_array->children[0]->length == 3);
+    const int32_t* ints = static_cast<const int32_t*>(df_array->children[0]->children[0]->buffers[1]);
+    expect_true(ints[2] == 3);
+
+    schema.release(&schema);
+    array.release(&array);
+  }
+}
@@ -0,0 +1,58 @@
+// All test files should include the <testthat.h>
+// header file.
+#include <cpp11/materialize.hpp>
+#include <testthat.h>
+
+context("Column_Buffer") {
+  test_that("tracks missing values in the validity bitmap") {
+    Column_Buffer<int32_t> x;
+    x.reset(2);
+    for (int i = 0; i < 20; i++) {
+      x.push_back(i % 3 == 0 ? NA_INTEGER : i);
+    }
+    expect_true(x.size() == 20);
+    expect_true(x.get_validity().get_null_count() == 7);
+
+    for (int i = 0; i < 12; i++) {
+      x.pop_back();
+    }
+    expect_true(x.get_validity().size() == 8);
+    expect_true(x.get_validity().get_null_count() == 3);
+    expect_true(!x.get_validity().is_valid(6));
+    expect_true(x.get_validity().is_valid(7));
+  }
+
+  test_that("materializes with R's missing values") {
+    Column_Buffer<double> x;
+    x.reset(3);
+    x.push_back(1.5);
+    x.push_back(NA_REAL);
+    x.push_back(-1);
+
+    cpp11::doubles out = materialize_double(x);
+    expect_true(out.size() == 3);
+    expect_true(out[0] == 1.5);
+    expect_true(cpp11::is_na(out[1]));
+    expect_true(out[2] == -1);
+  }
+}
+
+context("String_Buffer") {
+  test_that("stores strings contiguously") {
+    String_Buffer x;
+    x.reset(3);
+    x.push_back("ab");
+    x.push_null();
+    x.push_back("cde");
+    x.pop_back();
+    x.push_back("x");
+
+    expect_true(x.size() == 3);
+    expect_true(x.get(0) == "ab");
+    expect_true(x.get(2) == "x");
+    expect_true(x.offsets_data()[3] == 3);
+
+    cpp11::strings out = materialize_character(x);
+    expect_true(out == cpp11::writable::strings({"ab", NA_STRING, "x"}));
+  }
+}
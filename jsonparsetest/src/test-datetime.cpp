@@ -0,0 +1,97 @@
+// All test files should include the <testthat.h>
+// header file.
+#include <cpp11/parse.hpp>
+#include <testthat.h>
+
+context("parse_iso8601") {
+  double out;
+
+  test_that("can parse dates") {
+    expect_true(parse_iso8601_date("1970-01-01", out) && out == 0);
+    expect_true(parse_iso8601_date("2000-03-01", out) && out == 11017);
+    expect_true(parse_iso8601_date("2020-02-29", out));
+    expect_false(parse_iso8601_date("2021-02-29", out));
+    expect_false(parse_iso8601_date("2021-1-01", out));
+    expect_false(parse_iso8601_date("2021-01-01T00:00:00", out));
+  }
+
+  test_that("can parse datetimes") {
+    expect_true(parse_iso8601_datetime("2021-10-05T12:34:56Z", out) && out == 1633437296);
+    expect_true(parse_iso8601_datetime("2021-10-05 12:34:56", out) && out == 1633437296);
+    expect_true(parse_iso8601_datetime("2021-10-05", out) && out == 1633392000);
+    expect_true(parse_iso8601_datetime("1969-12-31T23:59:59.5Z", out) && out == -0.5);
+  }
+
+  test_that("applies offsets") {
+    expect_true(parse_iso8601_datetime("2021-10-05T12:34:56.25+02:00", out) && out == 1633430096.25);
+    expect_true(parse_iso8601_datetime("2021-10-05T12:34:56-0130", out) && out == 1633442696);
+    expect_true(parse_iso8601_datetime("2021-10-05T12:34:56+02", out) && out == 1633430096);
+  }
+
+  test_that("rejects invalid datetimes") {
+    expect_false(parse_iso8601_datetime("2021-10-05T12:34", out));
+    expect_false(parse_iso8601_datetime("2021-10-05T24:00:00", out));
+    expect_false(parse_iso8601_datetime("2021-10-05T12:34:56.", out));
+    expect_false(parse_iso8601_datetime("2021-10-05T12:34:56+2", out));
+    expect_false(parse_iso8601_datetime("2021-10-05T12:34:56Zx", out));
+  }
+}
+
+context("parse_scalar_datetime") {
+  using namespace simdjson;
+  ondemand::parser parser;
+  auto json = R"(  {
+    "datetime": "2021-10-05T12:34:56Z", "date": "2000-03-01", "null": null,
+    "escaped": "2021-10-05T12:34:56\u005A", "bad": "2021-13-01", "num": 1
+  }  )"_padded;
+  auto doc = parser.iterate(json);
+
+  auto p = JSON_Path();
+
+  test_that("can parse a scalar datetime") {
+    expect_true(parse_scalar_datetime(doc["datetime"].value(), p) == 1633437296);
+    expect_true(parse_scalar_datetime(doc["escaped"].value(), p) == 1633437296);
+    expect_true(cpp11::is_na(parse_scalar_datetime(doc["null"].value(), p)));
+    expect_error(parse_scalar_datetime(doc["bad"].value(), p));
+    expect_error(parse_scalar_datetime(doc["num"].value(), p));
+  }
+
+  test_that("can parse a scalar date") {
+    expect_true(parse_scalar_date(doc["date"].value(), p) == 11017);
+    expect_true(cpp11::is_na(parse_scalar_date(doc["null"].value(), p)));
+  }
+}
+
+context("parse_scalar_epoch") {
+  using namespace simdjson;
+  ondemand::parser parser;
+  auto json = R"(  {
+    "s": 1633437296, "ms": 1633437296250, "ns": 1633437296123456789,
+    "dbl": 1633437296.5, "null": null, "str": "1", "huge": 1e30
+  }  )"_padded;
+  auto doc = parser.iterate(json);
+
+  auto p = JSON_Path();
+
+  test_that("converts epoch numbers to seconds") {
+    expect_true(parse_scalar_epoch(doc["s"].value(), epoch_units_per_second("s"), p) == 1633437296);
+    expect_true(parse_scalar_epoch(doc["ms"].value(), epoch_units_per_second("ms"), p) == 1633437296.25);
+    expect_true(parse_scalar_epoch(doc["dbl"].value(), epoch_units_per_second("s"), p) == 1633437296.5);
+    expect_true(cpp11::is_na(parse_scalar_epoch(doc["null"].value(), 1, p)));
+    expect_error(parse_scalar_epoch(doc["str"].value(), 1, p));
+  }
+
+  test_that("keeps nanoseconds exactly") {
+    expect_true(parse_scalar_epoch_ns(doc["ns"].value(), epoch_units_per_second("ns"), p) == 1633437296123456789);
+    expect_true(parse_scalar_epoch_ns(doc["s"].value(), epoch_units_per_second("s"), p) == 1633437296000000000);
+    expect_true(parse_scalar_epoch_ns(doc["null"].value(), 1, p) == NA_INTEGER64);
+  }
+
+  test_that("errors on doubles out of the int64 range") {
+    expect_error(parse_scalar_epoch_ns(doc["huge"].value(), epoch_units_per_second("s"), p));
+  }
+
+  test_that("errors on unknown units") {
+    expect_error(epoch_units_per_second("min"));
+  }
+}
@@ -0,0 +1,77 @@
+// All test files should include the <testthat.h>
+// header file.
+#include <cpp11/infer_spec.hpp>
+#include <testthat.h>
+
+context("Type_Collector") {
+  using namespace simdjson;
+
+  auto json = R"(  [{
+    "lgl": true,
+    "int": 1,
+    "dbl": 1,
+    "str": "abc",
+    "null": null,
+    "int_vec": [1, 2],
+    "empty_vec": [],
+    "df": {"a": 1},
+    "df_vec": [{"a": 1}, {"a": "x"}],
+    "mixed": 1,
+    "auto": 1
+  },
+  {
+    "lgl": null,
+    "int": 2,
+    "dbl": 2.5,
+    "str": "def",
+    "null": null,
+    "int_vec": [null, 3],
+    "empty_vec": [{"b": true}],
+    "df": {"a": 2, "b": [true]},
+    "df_vec": [],
+    "mixed": true,
+    "auto": "a"
+  }]  )"_padded;
+
+  ondemand::parser parser;
+  auto doc = parser.iterate(json);
+
+  auto collector = Type_Collector();
+  for (auto element : doc.get_array()) {
+    collector.add_element(element.value());
+  }
+
+  test_that("infers scalar types") {
+    expect_true(collector.field("lgl").type_name() == "lgl");
+    expect_true(collector.field("int").type_name() == "int");
+    expect_true(collector.field("str").type_name() == "str");
+    expect_true(collector.field("null").type_name() == "lgl");
+  }
+
+  test_that("promotes integers to doubles") {
+    expect_true(collector.field("dbl").type_name() == "dbl");
+    expect_true(collector.field("int_vec").type_name() == "int_vec");
+  }
+
+  test_that("infers nullability") {
+    expect_true(collector.field("lgl").is_nullable(2));
+    expect_false(collector.field("int").is_nullable(2));
+    expect_true(collector.field("df").field("b").is_nullable(2));
+  }
+
+  test_that("infers nested types") {
+    expect_true(collector.field("df").type_name() == "df");
+    expect_true(collector.field("df").field("a").type_name() == "int");
+    expect_true(collector.field("df_vec").type_name() == "df_vec");
+    expect_true(collector.field("df_vec").field("a").type_name() == "auto");
+    expect_true(collector.field("empty_vec").type_name() == "df_vec");
+  }
+
+  test_that("uses an adaptive column for numbers mixed with strings") {
+    expect_true(collector.field("auto").type_name() == "auto");
+  }
+
+  test_that("detects incompatible types") {
+    expect_true(collector.field("mixed").type_name() == "mixed");
+  }
+}
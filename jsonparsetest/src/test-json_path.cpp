@@ -19,3 +19,39 @@ context("json_path") {
     expect_true(path.path() == "/a");
   }
 }
+
+context("json_path_to") {
+  test_that("can reconstruct the path of a location") {
+    std::string_view json = R"([{"a": 1, "b\"c": [true, "x"]}, {"a": {"d": null}}])";
+    auto path = JSON_Path();
+    path.set_document(json);
+
+    expect_true(path.path_to(json.data()) == "");
+    expect_true(path.path_to(json.data() + json.find("1")) == "[0]/a");
+    expect_true(path.path_to(json.data() + json.find("\"x\"")) == "[0]/b\"c[1]");
+    expect_true(path.path_to(json.data() + json.find("null")) == "[1]/a/d");
+  }
+
+  test_that("prepends the explicit path") {
+    std::string_view json = R"({"a": [1, 2]})";
+    auto path = JSON_Path();
+    path.insert(3);
+    path.set_document(json);
+
+    expect_true(path.path_to(json.data() + json.find("2")) == "[3]/a[1]");
+  }
+}
+
+context("json_path_to resumes") {
+  test_that("gives the same paths when called in and out of document order") {
+    std::string_view json = R"([{"a": 1, "b": [true, "x"]}, {"a": {"d": null}}])";
+    auto path = JSON_Path();
+    path.set_document(json);
+
+    expect_true(path.path_to(json.data() + json.find("1")) == "[0]/a");
+    expect_true(path.path_to(json.data() + json.find("\"x\"")) == "[0]/b[1]");
+    expect_true(path.path_to(json.data() + json.find("null")) == "[1]/a/d");
+    expect_true(path.path_to(json.data() + json.find("true")) == "[0]/b[0]");
+    expect_true(path.path_to(json.data() + json.find("null")) == "[1]/a/d");
+  }
+}
@@ -1,6 +1,7 @@
 // All test files should include the <testthat.h>
 // header file.
 #include <cpp11/parse.hpp>
+#include <cpp11/simdjson_kernel.hpp>
 #include <testthat.h>
 
 context("parse_scalar") {
@@ -10,7 +11,8 @@ context("parse_scalar") {
     "lgl_true": true, "lgl_false": false, "lgl_null": null,
     "int_1": 1, "int_null": null,
     "dbl_1.5": 1.5, "dbl_null": null,
-    "str_empty": "", "str_abc": "abc", "str_null": null
+    "str_empty": "", "str_abc": "abc", "str_null": null,
+    "str_utf8": "\u00e9t\u00e9", "str_escaped": "a\"b", "str_nul": "a\u0000b"
   }  )"_padded;
   auto doc = parser.iterate(json);
 
@@ -37,6 +39,24 @@ context("parse_scalar") {
     expect_true(cpp11::r_string(parse_scalar_string(doc["str_abc"].value(), p)) == "abc");
     expect_true(parse_scalar_string(doc["str_null"].value(), p) == NA_STRING);
   }
+
+  test_that("strings are marked as UTF-8") {
+    SEXP x = parse_scalar_string(doc["str_utf8"].value(), p);
+    expect_true(cpp11::r_string(x) == "\u00e9t\u00e9");
+    expect_true(Rf_getCharCE(x) == CE_UTF8);
+    expect_true(cpp11::r_string(parse_scalar_string(doc["str_escaped"].value(), p)) == "a\"b");
+  }
+
+  test_that("a string with NUL raises an error") {
+    expect_error(parse_scalar_string(doc["str_nul"].value(), p));
+  }
+}
+
+context("padded_json") {
+  test_that("copies the first string") {
+    cpp11::writable::strings json({"[1, 2]"});
+    expect_true(std::string_view(padded_json(json)) == "[1, 2]");
+  }
 }
 
 context("parse_homo_array") {
@@ -46,7 +66,8 @@ context("parse_homo_array") {
     "lgl": [true, null, false],
     "int": [1, null, 2],
     "dbl": [1.5, null, -1.5],
-    "str": ["", null, "abc"]
+    "str": ["", null, "abc"],
+    "obj": {}
   }  )"_padded;
   auto doc = parser.iterate(json);
 
@@ -79,4 +100,140 @@ context("parse_homo_array") {
     expect_true(x[1] == NA_STRING);
     expect_true(x[2] == "abc");
   }
+
+  test_that("a non-array is NULL with `na`") {
+    auto problems = Problems(Error_Mode::na);
+    auto path = JSON_Path();
+    path.set_problems(&problems);
+    expect_true(parse_homo_array<int>(doc["obj"].value(), path) == R_NilValue);
+  }
+}
+
+context("parse_number_array") {
+  using namespace simdjson;
+  ondemand::parser parser;
+  auto json = R"(  {
+    "int": [1, 2, null, -3, 4, 5, null],
+    "int_big": [1, 3000000000],
+    "dbl": [1, 2.5e3, null, -0.25, 1e300]
+  }  )"_padded;
+  auto doc = parser.iterate(json);
+
+  auto p = JSON_Path();
+
+  test_that("decodes runs of numbers around nulls") {
+    cpp11::integers x = parse_homo_array<int>(doc["int"].value(), p);
+    expect_true(x == cpp11::integers({1, 2, NA_INTEGER, -3, 4, 5, NA_INTEGER}));
+  }
+
+  test_that("ints out of range still raise an error") {
+    expect_error(parse_homo_array<int>(doc["int_big"].value(), p));
+  }
+
+  test_that("decodes integers and exponents as doubles") {
+    cpp11::doubles x = parse_homo_array<double>(doc["dbl"].value(), p);
+    expect_true(x[0] == 1);
+    expect_true(x[1] == 2500);
+    expect_true(cpp11::is_na(x[2]));
+    expect_true(x[3] == -0.25);
+    expect_true(x[4] == 1e300);
+  }
+}
+
+context("simdjson_kernel") {
+  test_that("can list and set the kernels") {
+    cpp11::list kernels = simdjson_kernels();
+    cpp11::strings name = kernels["name"];
+    cpp11::logicals supported = kernels["supported"];
+    cpp11::logicals active = kernels["active"];
+    std::string current = active_simdjson_kernel();
+
+    int n_active = 0;
+    std::string other = current;
+    for (R_xlen_t i = 0; i < name.size(); i++) {
+      if (active[i] == TRUE) {
+        n_active++;
+        expect_true(std::string(name[i]) == current);
+      } else if (supported[i] == TRUE) {
+        other = name[i];
+      }
+    }
+    expect_true(n_active == 1);
+
+    expect_true(set_simdjson_kernel(other) == current);
+    expect_true(active_simdjson_kernel() == other);
+    set_simdjson_kernel(current);
+    expect_true(active_simdjson_kernel() == current);
+  }
+
+  test_that("errors for an unknown kernel") {
+    expect_error(set_simdjson_kernel("not_a_kernel"));
+  }
+}
+
+context("append_unescaped") {
+  test_that("unescapes all escape sequences") {
+    std::string out = "x";
+    expect_true(append_unescaped(R"(a\"b\\c\/d\b\f\n\r\te)", out));
+    expect_true(out == "xa\"b\\c/d\b\f\n\r\te");
+  }
+
+  test_that("unescapes unicode escapes to UTF-8") {
+    std::string out;
+    expect_true(append_unescaped(R"(\u0041\u00e9\u4e2d\ud83d\ude00)", out));
+    expect_true(out == "Aé中\U0001F600");
+  }
+
+  test_that("rejects invalid escapes and lone surrogates") {
+    std::string out;
+    expect_false(append_unescaped(R"(a\x)", out));
+    expect_false(append_unescaped(R"(\u12)", out));
+    expect_false(append_unescaped(R"(\ud83d)", out));
+    expect_false(append_unescaped(R"(\ude00)", out));
+    expect_false(append_unescaped("a\\", out));
+  }
+
+  test_that("rejects NUL") {
+    std::string out;
+    expect_false(append_unescaped(R"(a\u0000b)", out));
+  }
+}
+
+context("append_scalar_string") {
+  using namespace simdjson;
+  ondemand::parser parser;
+  auto json = R"(  ["plain", "esc\"aped", null, "é"]  )"_padded;
+  auto doc = parser.iterate(json);
+  auto p = JSON_Path();
+
+  test_that("appends plain and escaped strings") {
+    String_Buffer buffer;
+    for (auto element : doc.get_array()) {
+      append_scalar_string(buffer, element.value(), p);
+    }
+
+    expect_true(buffer.size() == 4);
+    expect_true(buffer.get(0) == "plain");
+    expect_true(buffer.get(1) == "esc\"aped");
+    expect_false(buffer.get_validity().is_valid(2));
+    expect_true(buffer.get(3) == "é");
+  }
+
+  test_that("a string with NUL is NA and a problem") {
+    auto json_nul = R"(  ["a\u0000b"]  )"_padded;
+    auto problems = Problems(Error_Mode::collect);
+    auto path = JSON_Path();
+    path.set_document(std::string_view(json_nul.data(), json_nul.size()));
+    path.set_problems(&problems);
+
+    String_Buffer buffer;
+    auto doc_nul = parser.iterate(json_nul);
+    for (auto element : doc_nul.get_array()) {
+      append_scalar_string(buffer, element.value(), path);
+    }
+
+    expect_true(buffer.size() == 1);
+    expect_false(buffer.get_validity().is_valid(0));
+    expect_true(problems.size() == 1);
+  }
 }
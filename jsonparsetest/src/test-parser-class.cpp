@@ -279,4 +279,558 @@ context("Parser_Dataframe") {
   doc = parser.iterate(json1);
   value = doc;
   expect_error(parser_df.parse_json(value, path));
+
+  test_that("can parse more columns than fit on the protection stack") {
+    std::unordered_map<std::string, std::unique_ptr<Column>> many_cols;
+    std::vector<std::string> many_col_order;
+    for (int i = 0; i < 20000; i++) {
+      std::string name = "x" + std::to_string(i);
+      many_cols[name] = std::make_unique<Column_Scalar<int>>(i);
+      many_col_order.push_back(name);
+    }
+    auto parser_many = Parser_Dataframe(many_cols, many_col_order);
+
+    auto json_many = R"(  [{"x1": -1}, {}]  )"_padded;
+    auto doc_many = parser.iterate(json_many);
+    simdjson::ondemand::value value_many = doc_many;
+    list x = parser_many.parse_json(value_many, path);
+    expect_true(x.size() == 20000);
+    expect_true(integers(x["x1"]) == integers({-1, 1}));
+    expect_true(integers(x["x19999"]) == integers({19999, 19999}));
+  }
+}
+
+context("Column_Adaptive") {
+  using namespace simdjson;
+  using namespace cpp11;
+
+  auto json = R"(  [
+    {"x": 1}, {"x": null}, {}, {"x": 1.5}, {"x": 10000000000}
+  ]  )"_padded;
+  auto json_str = R"(  [
+    {"x": 1}, {"x": 1e3}, {"x": 0.12345678901234567}, {}, {"x": "a"}, {"x": 1e3}
+  ]  )"_padded;
+
+  std::vector<std::string> col_order = std::vector<std::string>({"x"});
+  auto path = JSON_Path();
+  ondemand::parser parser;
+
+  test_that("promotes integers to doubles") {
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["x"] = std::make_unique<Column_Adaptive>(Rf_ScalarInteger(-1));
+    auto parser_df = Parser_Dataframe(cols, col_order);
+
+    auto doc = parser.iterate(json);
+    simdjson::ondemand::value value = doc;
+    list x = parser_df.parse_json(value, path);
+    doubles x_x = x["x"];
+    expect_true(x_x[0] == 1);
+    expect_true(is_na(x_x[1]));
+    expect_true(x_x[2] == -1);
+    expect_true(x_x[3] == 1.5);
+    expect_true(x_x[4] == 1e10);
+  }
+
+  test_that("promotes numbers to strings") {
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["x"] = std::make_unique<Column_Adaptive>(Rf_ScalarInteger(NA_INTEGER));
+    auto parser_df = Parser_Dataframe(cols, col_order);
+
+    auto doc = parser.iterate(json_str);
+    simdjson::ondemand::value value = doc;
+    list x = parser_df.parse_json(value, path);
+    expect_true(strings(x["x"]) == strings({"1", "1e3", "0.12345678901234567", NA_STRING, "a", "1e3"}));
+  }
+
+  test_that("a string default doesn't make it a string column") {
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["x"] = std::make_unique<Column_Adaptive>(Rf_mkString("-1"));
+    auto parser_df = Parser_Dataframe(cols, col_order);
+
+    auto doc = parser.iterate(json);
+    simdjson::ondemand::value value = doc;
+    list x = parser_df.parse_json(value, path);
+    doubles x_x = x["x"];
+    expect_true(x_x[0] == 1);
+    expect_true(x_x[2] == -1);
+    expect_true(x_x[4] == 1e10);
+  }
+}
+
+context("Parser_Dataframe with filter") {
+  using namespace simdjson;
+  using namespace cpp11;
+
+  auto json = R"(  [
+    {"x": 1, "type": "purchase", "y": "a"},
+    {"x": 2, "type": "view", "y": "b"},
+    {"type": "purchase", "x": 3},
+    {"x": 4, "y": "d"}
+  ]  )"_padded;
+
+  std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+  cols["x"] = std::make_unique<Column_Scalar<int>>(-1);
+  cols["y"] = std::make_unique<Column_Scalar<std::string>>("z");
+  std::vector<std::string> col_order = std::vector<std::string>({"x", "y"});
+  std::vector<std::pair<std::string, Row_Filter>> filters;
+  filters.push_back({"type", Row_Filter("==", std::string("purchase"))});
+
+  auto parser_df = Parser_Dataframe(cols, col_order, filters);
+  auto path = JSON_Path();
+
+  ondemand::parser parser;
+  auto doc = parser.iterate(json);
+  simdjson::ondemand::value value = doc;
+  test_that("only keeps rows matching the filter") {
+    list x = parser_df.parse_json(value, path);
+    expect_true(integers(x["x"]) == integers({1, 3}));
+    expect_true(strings(x["y"]) == strings({"a", "z"}));
+  }
+
+  test_that("counts a repeated filter key once") {
+    auto json_dup = R"(  [
+      {"type": "purchase", "type": "purchase"},
+      {"type": "purchase", "status": "ok", "x": 2}
+    ]  )"_padded;
+
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols_dup;
+    cols_dup["x"] = std::make_unique<Column_Scalar<int>>(-1);
+    std::vector<std::pair<std::string, Row_Filter>> filters_dup;
+    filters_dup.push_back({"type", Row_Filter("==", std::string("purchase"))});
+    filters_dup.push_back({"status", Row_Filter("==", std::string("ok"))});
+    auto parser_dup = Parser_Dataframe(cols_dup, std::vector<std::string>({"x"}), filters_dup);
+
+    auto doc_dup = parser.iterate(json_dup);
+    simdjson::ondemand::value value_dup = doc_dup;
+    list x = parser_dup.parse_json(value_dup, path);
+    expect_true(integers(x["x"]) == integers({2}));
+  }
+}
+
+context("Parser_Dataframe with row sampler") {
+  using namespace simdjson;
+  using namespace cpp11;
+
+  auto json = R"(  [{"x": 1}, {"x": 2}, {"x": 3}, {"x": 4}]  )"_padded;
+  auto ndjson = simdjson::padded_string(std::string("{\"x\": 1}\n{\"x\": 2}\r\n\n{\"x\": 3}\n{\"x\": 4}"));
+
+  std::vector<std::string> col_order = std::vector<std::string>({"x"});
+  auto path = JSON_Path();
+  ondemand::parser parser;
+
+  test_that("can skip rows and limit the number of rows") {
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["x"] = std::make_unique<Column_Scalar<int>>(-1);
+    auto parser_df = Parser_Dataframe(cols, col_order, {}, Row_Sampler(1, 2, 1, -1));
+
+    auto doc = parser.iterate(json);
+    simdjson::ondemand::value value = doc;
+    list x = parser_df.parse_json(value, path);
+    expect_true(integers(x["x"]) == integers({2, 3}));
+  }
+
+  test_that("can parse newline delimited JSON") {
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["x"] = std::make_unique<Column_Scalar<int>>(-1);
+    auto parser_df = Parser_Dataframe(cols, col_order, {}, Row_Sampler(0, 3, 1, -1));
+
+    list x = parser_df.parse_ndjson(ndjson, parser, path);
+    expect_true(integers(x["x"]) == integers({1, 2, 3}));
+  }
+
+  test_that("sample_size larger than the number of rows keeps all rows") {
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["x"] = std::make_unique<Column_Scalar<int>>(-1);
+    auto parser_df = Parser_Dataframe(cols, col_order, {}, Row_Sampler(0, -1, 1, 10));
+
+    list x = parser_df.parse_ndjson(ndjson, parser, path);
+    expect_true(integers(x["x"]) == integers({1, 2, 3, 4}));
+  }
+
+  test_that("sampling needs an Rng_State::Scope") {
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["x"] = std::make_unique<Column_Scalar<int>>(-1);
+    auto parser_df = Parser_Dataframe(cols, col_order, {}, Row_Sampler(0, -1, 1, 2));
+
+    expect_error(parser_df.parse_ndjson(ndjson, parser, path));
+
+    Rng_State::Scope rng_scope;
+    list x = parser_df.parse_ndjson(ndjson, parser, path);
+    expect_true(Rf_xlength(x["x"]) == 2);
+  }
+}
+
+context("Parser_Dataframe with problems") {
+  using namespace simdjson;
+  using namespace cpp11;
+
+  auto json = R"(  [
+    {"x": 1, "y": "a"}, {"x": "b", "y": "c"}, 2, {"x": 1.5, "y": 3}
+  ]  )"_padded;
+
+  std::vector<std::string> col_order = std::vector<std::string>({"x", "y"});
+  ondemand::parser parser;
+
+  test_that("raises an error by default") {
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["x"] = std::make_unique<Column_Scalar<int>>(-1);
+    cols["y"] = std::make_unique<Column_Scalar<std::string>>("z");
+    auto parser_df = Parser_Dataframe(cols, col_order);
+    auto problems = Problems(Error_Mode::stop);
+    auto path = JSON_Path();
+    path.set_problems(&problems);
+
+    auto doc = parser.iterate(json);
+    simdjson::ondemand::value value = doc;
+    expect_error(parser_df.parse_json(value, path));
+  }
+
+  test_that("writes missing values and collects the problems") {
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["x"] = std::make_unique<Column_Scalar<int>>(-1);
+    cols["y"] = std::make_unique<Column_Scalar<std::string>>("z");
+    auto parser_df = Parser_Dataframe(cols, col_order);
+    auto problems = Problems(Error_Mode::collect);
+    auto path = JSON_Path();
+    path.set_document(std::string_view(json.data(), json.size()));
+    path.set_problems(&problems);
+
+    auto doc = parser.iterate(json);
+    simdjson::ondemand::value value = doc;
+    list x = parser_df.parse_json(value, path);
+    expect_true(integers(x["x"]) == integers({1, NA_INTEGER, -1, NA_INTEGER}));
+    expect_true(as_string(strings(x["y"])[0]) == "a");
+    expect_true(as_string(strings(x["y"])[2]) == "z");
+    expect_true(is_na(strings(x["y"])[3]));
+
+    list p = problems.get_value();
+    expect_true(integers(p["row"]) == integers({2, 3, 4, 4}));
+    expect_true(strings(p["path"]) == strings({"[1]/x", "[2]", "[3]/x", "[3]/y"}));
+    expect_true(strings(p["expected"]) == strings({"int", "object", "int", "string"}));
+    expect_true(strings(p["actual"]) == strings({"string", "number", "1.5", "number"}));
+  }
+
+  test_that("records the row of the result") {
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["x"] = std::make_unique<Column_Scalar<int>>(-1);
+    cols["y"] = std::make_unique<Column_Scalar<std::string>>("z");
+    auto parser_df = Parser_Dataframe(cols, col_order, {}, Row_Sampler(1, -1, 1, -1));
+    auto problems = Problems(Error_Mode::collect);
+    auto path = JSON_Path();
+    path.set_document(std::string_view(json.data(), json.size()));
+    path.set_problems(&problems);
+
+    auto doc = parser.iterate(json);
+    simdjson::ondemand::value value = doc;
+    list x = parser_df.parse_json(value, path);
+    expect_true(integers(x["x"]) == integers({NA_INTEGER, -1, NA_INTEGER}));
+
+    list p = problems.get_value();
+    expect_true(integers(p["row"]) == integers({1, 2, 3, 3}));
+    expect_true(strings(p["path"]) == strings({"[1]/x", "[2]", "[3]/x", "[3]/y"}));
+  }
+
+  test_that("records nothing with `na`") {
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["x"] = std::make_unique<Column_Scalar<int>>(-1);
+    cols["y"] = std::make_unique<Column_Scalar<std::string>>("z");
+    auto parser_df = Parser_Dataframe(cols, col_order);
+    auto problems = Problems(Error_Mode::na);
+    auto path = JSON_Path();
+    path.set_problems(&problems);
+
+    auto doc = parser.iterate(json);
+    simdjson::ondemand::value value = doc;
+    list x = parser_df.parse_json(value, path);
+    expect_true(integers(x["x"]) == integers({1, NA_INTEGER, -1, NA_INTEGER}));
+    expect_true(problems.size() == 0);
+  }
+}
+
+context("Matrix") {
+  using namespace simdjson;
+  using namespace cpp11;
+
+  ondemand::parser parser;
+
+  test_that("Parser_Matrix parses equal length arrays into a matrix") {
+    auto json = R"(  [[1, 2, 3], [4, null, 6]]  )"_padded;
+    auto doc = parser.iterate(json);
+    auto path = JSON_Path();
+
+    auto parser_mat = Parser_Matrix<double>(-1);
+    doubles x = parser_mat.parse_json(doc.get_value(), path);
+    expect_true(Rf_nrows(x) == 2);
+    expect_true(Rf_ncols(x) == 3);
+    expect_true(x[0] == 1 && x[1] == 4 && x[2] == 2 && x[4] == 3 && x[5] == 6);
+    expect_true(is_na(x[3]));
+  }
+
+  test_that("Parser_Matrix raises an error for ragged rows") {
+    auto json = R"(  [[1, 2], [3]]  )"_padded;
+    auto doc = parser.iterate(json);
+    auto path = JSON_Path();
+
+    auto parser_mat = Parser_Matrix<int>(2);
+    expect_error(parser_mat.parse_json(doc.get_value(), path));
+  }
+
+  test_that("Column_Matrix fills missing and ragged rows with NA") {
+    auto json = R"(  [{"m": [1, 2]}, {"m": null}, {"m": [3]}, {"m": [4, 5]}]  )"_padded;
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["m"] = std::make_unique<Column_Matrix<int>>(-1);
+    auto parser_df = Parser_Dataframe(cols, std::vector<std::string>({"m"}));
+    auto problems = Problems(Error_Mode::collect);
+    auto path = JSON_Path();
+    path.set_document(std::string_view(json.data(), json.size()));
+    path.set_problems(&problems);
+
+    auto doc = parser.iterate(json);
+    simdjson::ondemand::value value = doc;
+    list x = parser_df.parse_json(value, path);
+    integers m = x["m"];
+    expect_true(Rf_nrows(m) == 4);
+    expect_true(Rf_ncols(m) == 2);
+    expect_true(m == integers({1, NA_INTEGER, NA_INTEGER, 4, 2, NA_INTEGER, NA_INTEGER, 5}));
+
+    list p = problems.get_value();
+    expect_true(strings(p["path"]) == strings({"[2]/m"}));
+    expect_true(strings(p["expected"]) == strings({"array of length 2"}));
+  }
+}
+
+context("Map") {
+  using namespace simdjson;
+  using namespace cpp11;
+
+  ondemand::parser parser;
+
+  test_that("Parser_Map parses an object into keys and values") {
+    auto json = R"(  {"sku123": 4, "sku456": null, "a\"b": 1}  )"_padded;
+    auto doc = parser.iterate(json);
+    auto path = JSON_Path();
+
+    auto parser_map = Parser_Map<int>();
+    list x = parser_map.parse_json(doc.get_value(), path);
+    expect_true(strings(x["key"]) == strings({"sku123", "sku456", "a\"b"}));
+    expect_true(integers(x["value"]) == integers({4, NA_INTEGER, 1}));
+  }
+
+  test_that("Column_Map gives a named vector per row") {
+    auto json = R"(  [
+      {"m": {"a": "x", "b": "y"}}, {"m": null}, {}, {"m": {}}, {"m": {"c": "z"}}
+    ]  )"_padded;
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["m"] = std::make_unique<Column_Map<std::string>>(R_NilValue);
+    auto parser_df = Parser_Dataframe(cols, std::vector<std::string>({"m"}));
+    auto path = JSON_Path();
+
+    auto doc = parser.iterate(json);
+    simdjson::ondemand::value value = doc;
+    list x = parser_df.parse_json(value, path);
+    list m = x["m"];
+    expect_true(m.size() == 5);
+
+    strings m1 = m[0];
+    expect_true(m1 == strings({"x", "y"}));
+    expect_true(strings(m1.names()) == strings({"a", "b"}));
+    expect_true(Rf_isNull(m[1]));
+    expect_true(Rf_isNull(m[2]));
+    expect_true(Rf_length(m[3]) == 0);
+    expect_true(strings(strings(m[4]).names()) == strings({"c"}));
+  }
+}
+
+context("Column_Vector") {
+  using namespace simdjson;
+  using namespace cpp11;
+
+  ondemand::parser parser;
+
+  test_that("all rows share one buffer and empty arrays become NULL") {
+    auto json = R"(  [[1, 2], [], [3], [4, 5]]  )"_padded;
+    auto col = Column_Vector<int>(integers({-1}));
+    auto path = JSON_Path();
+    col.reserve(1);
+
+    auto doc = parser.iterate(json);
+    int i = 0;
+    for (auto element : doc.get_array()) {
+      col.add_value(element.value(), path);
+      if (i == 2) {
+        col.discard_row();
+      } else {
+        col.finalize_row();
+      }
+      i++;
+    }
+    col.finalize_row();
+
+    list x = col.get_value();
+    expect_true(x.size() == 4);
+    expect_true(integers(x[0]) == integers({1, 2}));
+    expect_true(Rf_isNull(x[1]));
+    expect_true(integers(x[2]) == integers({4, 5}));
+    expect_true(integers(x[3]) == integers({-1}));
+  }
+}
+
+context("Column_UnnestedDf") {
+  using namespace simdjson;
+  using namespace cpp11;
+
+  auto json = R"(  [
+    {"id": 1, "lines": [{"sku": "a", "n": 1}, {"sku": "b", "n": 2}], "keep": 1},
+    {"id": 2, "lines": [], "keep": 1},
+    {"id": 3, "lines": [{"sku": "c", "n": 3}], "keep": 0},
+    {"id": 4, "lines": [{"sku": "d"}, {"sku": "e", "n": 5}, {"sku": "f", "n": 6}], "keep": 1}
+  ]  )"_padded;
+  ondemand::parser parser;
+
+  auto make_cols = [](std::string parent_row_name) {
+    std::unordered_map<std::string, std::unique_ptr<Column>> line_cols;
+    line_cols["sku"] = std::make_unique<Column_Scalar<std::string>>("z");
+    line_cols["n"] = std::make_unique<Column_Scalar<int>>(NA_INTEGER);
+
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["id"] = std::make_unique<Column_Scalar<int>>(NA_INTEGER);
+    cols["lines"] = std::make_unique<Column_UnnestedDf>(line_cols, std::vector<std::string>({"sku", "n"}),
+                                                        std::vector<std::pair<std::string, Row_Filter>>(),
+                                                        parent_row_name);
+    return cols;
+  };
+
+  test_that("repeats the parent columns for each nested row") {
+    auto cols = make_cols("");
+    auto parser_df = Parser_Dataframe(cols, std::vector<std::string>({"id", "lines"}));
+    auto path = JSON_Path();
+
+    auto doc = parser.iterate(json);
+    simdjson::ondemand::value value = doc;
+    list x = parser_df.parse_json(value, path);
+    expect_true(strings(x.names()) == strings({"id", "sku", "n"}));
+    expect_true(integers(x["id"]) == integers({1, 1, 3, 4, 4, 4}));
+    expect_true(strings(x["sku"]) == strings({"a", "b", "c", "d", "e", "f"}));
+    expect_true(integers(x["n"]) == integers({1, 2, 3, NA_INTEGER, 5, 6}));
+  }
+
+  test_that("drops the nested rows of rows rejected by a filter") {
+    auto cols = make_cols("row");
+    std::vector<std::pair<std::string, Row_Filter>> filters = {{"keep", Row_Filter("!=", 0.0)}};
+    auto parser_df = Parser_Dataframe(cols, std::vector<std::string>({"id", "lines"}), filters);
+    auto path = JSON_Path();
+
+    auto doc = parser.iterate(json);
+    simdjson::ondemand::value value = doc;
+    list x = parser_df.parse_json(value, path);
+    expect_true(strings(x.names()) == strings({"id", "row", "sku", "n"}));
+    expect_true(integers(x["id"]) == integers({1, 1, 4, 4, 4}));
+    expect_true(integers(x["row"]) == integers({1, 1, 3, 3, 3}));
+    expect_true(strings(x["sku"]) == strings({"a", "b", "d", "e", "f"}));
+  }
+}
+
+context("Column_ListOfDf") {
+  using namespace simdjson;
+  using namespace cpp11;
+
+  auto json = R"(  [
+    {"lines": [{"sku": "a"}, {"sku": "b"}], "keep": 1},
+    {"lines": null, "keep": 1},
+    {"lines": [{"sku": "c"}], "keep": 0},
+    {"keep": 1},
+    {"lines": [], "keep": 1},
+    {"lines": [{"sku": "d"}], "keep": 1}
+  ]  )"_padded;
+  ondemand::parser parser;
+
+  test_that("slices the nested data frames from shared columns") {
+    std::unordered_map<std::string, std::unique_ptr<Column>> line_cols;
+    line_cols["sku"] = std::make_unique<Column_Scalar<std::string>>("z");
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["lines"] = std::make_unique<Column_ListOfDf>(line_cols, std::vector<std::string>({"sku"}));
+    std::vector<std::pair<std::string, Row_Filter>> filters = {{"keep", Row_Filter("!=", 0.0)}};
+    auto parser_df = Parser_Dataframe(cols, std::vector<std::string>({"lines"}), filters);
+    auto path = JSON_Path();
+
+    auto doc = parser.iterate(json);
+    simdjson::ondemand::value value = doc;
+    list x = parser_df.parse_json(value, path);
+    list lines = x["lines"];
+    expect_true(lines.size() == 5);
+
+    expect_true(strings(list(lines[0])["sku"]) == strings({"a", "b"}));
+    expect_true(Rf_inherits(lines[0], "tbl_df"));
+    expect_true(Rf_isNull(lines[1]));
+    expect_true(Rf_isNull(lines[2]));
+    expect_true(Rf_xlength(list(lines[3])["sku"]) == 0);
+    expect_true(strings(list(lines[4])["sku"]) == strings({"d"}));
+  }
+}
+
+context("Parse_Stats") {
+  using namespace simdjson;
+  using namespace cpp11;
+
+  test_that("columns count values, nulls, defaults, string bytes and unknown keys") {
+    auto json = R"(  [
+      {"x": 1, "y": "ab", "z": true},
+      {"x": null},
+      {"y": "a\"b", "w": 1}
+    ]  )"_padded;
+    auto stats = Parse_Stats();
+    Column_Stats* root_stats = stats.add("");
+    Column_Stats* x_stats = stats.add("/x");
+    Column_Stats* y_stats = stats.add("/y");
+
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["x"] = std::make_unique<Column_Instrumented>(std::make_unique<Column_Scalar<int>>(-1), x_stats);
+    cols["y"] = std::make_unique<Column_Instrumented>(std::make_unique<Column_Scalar<std::string>>("z"), y_stats);
+    auto parser_df = Parser_Dataframe(cols, std::vector<std::string>({"x", "y"}));
+    parser_df.set_stats(root_stats);
+    auto path = JSON_Path();
+
+    ondemand::parser parser;
+    auto doc = parser.iterate(json);
+    simdjson::ondemand::value value = doc;
+    list x = parser_df.parse_json(value, path);
+    expect_true(integers(x["x"]) == integers({1, NA_INTEGER, -1}));
+
+    expect_true(x_stats->n_values == 2);
+    expect_true(x_stats->n_nulls == 1);
+    expect_true(x_stats->n_defaults == 1);
+    expect_true(y_stats->n_values == 2);
+    expect_true(y_stats->n_defaults == 1);
+    expect_true(y_stats->string_bytes == 6);
+    expect_true(root_stats->n_unknown_keys == 2);
+
+    list s = stats.get_value();
+    expect_true(strings(s["path"]) == strings({"", "/x", "/y"}));
+    expect_true(doubles(s["n_values"])[1] == 2);
+  }
+
+  test_that("columns record their memory") {
+    auto json = R"(  [{"x": "a"}, {"x": "b"}, {"x": "a"}, {"x": null}]  )"_padded;
+    auto stats = Parse_Stats();
+    Column_Stats* x_stats = stats.add("/x");
+
+    std::unordered_map<std::string, std::unique_ptr<Column>> cols;
+    cols["x"] = std::make_unique<Column_Instrumented>(std::make_unique<Column_Scalar<std::string>>("z"), x_stats);
+    auto parser_df = Parser_Dataframe(cols, std::vector<std::string>({"x"}));
+    auto path = JSON_Path();
+
+    ondemand::parser parser;
+    auto doc = parser.iterate(json);
+    simdjson::ondemand::value value = doc;
+    list x = parser_df.parse_json(value, path);
+    stats.set_parser_capacity(parser.capacity());
+
+    expect_true(Rf_xlength(x["x"]) == 4);
+    expect_true(x_stats->n_charsxp == 2);
+    expect_true(x_stats->r_bytes == r_vector_bytes(4 * sizeof(SEXP)) + 2 * r_vector_bytes(2));
+    expect_true(x_stats->buffer_bytes >= 2);
+
+    list s = stats.get_value();
+    expect_true(Rf_asReal(s.attr("parser_capacity")) >= json.size());
+  }
 }
@@ -0,0 +1,35 @@
+// All test files should include the <testthat.h>
+// header file.
+#include <cpp11/row_filter.hpp>
+#include <testthat.h>
+
+context("Row_Filter") {
+  using namespace simdjson;
+  ondemand::parser parser;
+  auto json = R"(  {
+    "str": "purchase", "str_escaped": "a\"b", "num": 3, "lgl": true, "null": null
+  }  )"_padded;
+  auto doc = parser.iterate(json);
+
+  test_that("can compare strings") {
+    expect_true(Row_Filter("==", std::string("purchase")).matches(doc["str"].value()));
+    expect_false(Row_Filter("!=", std::string("purchase")).matches(doc["str"].value()));
+    expect_true(Row_Filter(">", std::string("p")).matches(doc["str"].value()));
+    expect_true(Row_Filter("==", std::string("a\"b")).matches(doc["str_escaped"].value()));
+  }
+
+  test_that("can compare numbers") {
+    expect_true(Row_Filter(">=", 3).matches(doc["num"].value()));
+    expect_false(Row_Filter("<", 3).matches(doc["num"].value()));
+    expect_true(Row_Filter("==", 1).matches(doc["lgl"].value()));
+  }
+
+  test_that("rejects `null` and other types") {
+    expect_false(Row_Filter("==", std::string("3")).matches(doc["num"].value()));
+    expect_false(Row_Filter("!=", 1).matches(doc["null"].value()));
+  }
+
+  test_that("errors on unknown operators") {
+    expect_error(Row_Filter("=", 1));
+  }
+}
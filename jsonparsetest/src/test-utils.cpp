@@ -26,6 +26,15 @@ context("new_df") {
 
     expect_true(cpp11::list(df) == expected);
   }
+
+  test_that("can create a data.table") {
+    SEXP dt = PROTECT(new_df(std::vector<std::string>({"a", "b"}), 2, Df_Class::data_table));
+
+    expect_true(Rf_xlength(dt) == 2);
+    expect_true(Rf_inherits(dt, "data.table"));
+    expect_true(Rf_inherits(dt, "data.frame"));
+    UNPROTECT(1);
+  }
 }
 
 context("name_to_index") {
@@ -37,3 +46,18 @@ context("name_to_index") {
     expect_error(name_to_index(haystack, "c"));
   }
 }
+
+context("mk_utf8_char") {
+  test_that("creates a UTF-8 string from a view") {
+    std::string_view x = "été and more";
+    SEXP out = mk_utf8_char(x.substr(0, 5));
+    expect_true(cpp11::r_string(out) == "été");
+    expect_true(Rf_getCharCE(out) == CE_UTF8);
+  }
+
+  test_that("names are marked as UTF-8") {
+    SEXP list = new_named_list(std::vector<std::string>({"été"}));
+    SEXP nms = Rf_getAttrib(list, R_NamesSymbol);
+    expect_true(Rf_getCharCE(STRING_ELT(nms, 0)) == CE_UTF8);
+  }
+}
@@ -5,6 +5,13 @@
 #include "cpp11/declarations.hpp"
 #include <R_ext/Visibility.h>
 
+// infer_spec.cpp
+cpp11::list infer_spec(cpp11::strings json, int n_max, double prob);
+extern "C" SEXP _jsonparse_infer_spec(SEXP json, SEXP n_max, SEXP prob) {
+  BEGIN_CPP11
+    return cpp11::as_sexp(infer_spec(cpp11::as_cpp<cpp11::decay_t<cpp11::strings>>(json), cpp11::as_cpp<cpp11::decay_t<int>>(n_max), cpp11::as_cpp<cpp11::decay_t<double>>(prob)));
+  END_CPP11
+}
 // parse_json.cpp
 cpp11::sexp parse_json(cpp11::strings json, cpp11::list spec);
 extern "C" SEXP _jsonparse_parse_json(SEXP json, SEXP spec) {
@@ -12,16 +19,51 @@ extern "C" SEXP _jsonparse_parse_json(SEXP json, SEXP spec) {
     return cpp11::as_sexp(parse_json(cpp11::as_cpp<cpp11::decay_t<cpp11::strings>>(json), cpp11::as_cpp<cpp11::decay_t<cpp11::list>>(spec)));
   END_CPP11
 }
+// parse_json.cpp
+cpp11::sexp parse_ndjson(cpp11::strings json, cpp11::list spec);
+extern "C" SEXP _jsonparse_parse_ndjson(SEXP json, SEXP spec) {
+  BEGIN_CPP11
+    return cpp11::as_sexp(parse_ndjson(cpp11::as_cpp<cpp11::decay_t<cpp11::strings>>(json), cpp11::as_cpp<cpp11::decay_t<cpp11::list>>(spec)));
+  END_CPP11
+}
+// parse_json.cpp
+cpp11::sexp parse_json_arrow(cpp11::strings json, cpp11::list spec, SEXP schema_xptr, SEXP array_xptr, bool dictionary);
+extern "C" SEXP _jsonparse_parse_json_arrow(SEXP json, SEXP spec, SEXP schema_xptr, SEXP array_xptr, SEXP dictionary) {
+  BEGIN_CPP11
+    return cpp11::as_sexp(parse_json_arrow(cpp11::as_cpp<cpp11::decay_t<cpp11::strings>>(json), cpp11::as_cpp<cpp11::decay_t<cpp11::list>>(spec), cpp11::as_cpp<cpp11::decay_t<SEXP>>(schema_xptr), cpp11::as_cpp<cpp11::decay_t<SEXP>>(array_xptr), cpp11::as_cpp<cpp11::decay_t<bool>>(dictionary)));
+  END_CPP11
+}
+// parse_json.cpp
+cpp11::sexp simdjson_implementations();
+extern "C" SEXP _jsonparse_simdjson_implementations() {
+  BEGIN_CPP11
+    return cpp11::as_sexp(simdjson_implementations());
+  END_CPP11
+}
+// parse_json.cpp
+std::string set_simdjson_implementation(std::string name);
+extern "C" SEXP _jsonparse_set_simdjson_implementation(SEXP name) {
+  BEGIN_CPP11
+    return cpp11::as_sexp(set_simdjson_implementation(cpp11::as_cpp<cpp11::decay_t<std::string>>(name)));
+  END_CPP11
+}
 
 extern "C" {
 static const R_CallMethodDef CallEntries[] = {
-    {"_jsonparse_parse_json", (DL_FUNC) &_jsonparse_parse_json, 2},
+    {"_jsonparse_infer_spec",                  (DL_FUNC) &_jsonparse_infer_spec,                  3},
+    {"_jsonparse_parse_json",                  (DL_FUNC) &_jsonparse_parse_json,                  2},
+    {"_jsonparse_parse_json_arrow",            (DL_FUNC) &_jsonparse_parse_json_arrow,            5},
+    {"_jsonparse_parse_ndjson",                (DL_FUNC) &_jsonparse_parse_ndjson,                2},
+    {"_jsonparse_set_simdjson_implementation", (DL_FUNC) &_jsonparse_set_simdjson_implementation, 1},
+    {"_jsonparse_simdjson_implementations",    (DL_FUNC) &_jsonparse_simdjson_implementations,    0},
     {NULL, NULL, 0}
 };
 }
 
+void init_nested_df_class(DllInfo* dll);
 extern "C" attribute_visible void R_init_jsonparse(DllInfo* dll){
   R_registerRoutines(dll, NULL, CallEntries, NULL, NULL);
   R_useDynamicSymbols(dll, FALSE);
+  init_nested_df_class(dll);
   R_forceSymbols(dll, TRUE);
 }
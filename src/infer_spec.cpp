@@ -0,0 +1,52 @@
+#define STRICT_R_HEADERS
+#include "cpp11.hpp"
+#include "cpp11/R.hpp"
+
+#if __cplusplus >= 201703L
+#include "cpp11/simdjson.h"
+#include <cpp11/infer_spec.hpp>
+#include <cpp11/ndjson.hpp>
+#include <cpp11/row_sampler.hpp>
+#endif
+
+// `json` is either a JSON array of objects or newline delimited JSON.
+// Only the first `n_max` records are used (all if negative); of these
+// every record is used with probability `prob`.
+[[cpp11::register]]
+cpp11::list infer_spec(cpp11::strings json, int n_max, double prob) {
+  simdjson::ondemand::parser parser;
+  simdjson::padded_string content = padded_json(json);
+
+  bool sample = prob < 1;
+  Rng_State::Scope rng_scope;
+  if (sample) Rng_State::acquire();
+
+  auto collector = Type_Collector();
+  int n_records = 0;
+  if (is_json_array(content)) {
+    simdjson::ondemand::document doc = parser.iterate(content);
+    simdjson::ondemand::array array = doc.get_array();
+    for (auto element : array) {
+      if (n_max >= 0 && n_records >= n_max) break;
+      n_records++;
+      if (sample && unif_rand() >= prob) continue;
+
+      collector.add_element(element.value());
+    }
+  } else {
+    auto reader = Ndjson_Reader(content);
+    std::string_view line;
+    while (reader.next_line(line)) {
+      if (n_max >= 0 && n_records >= n_max) break;
+      n_records++;
+      // skipped lines are never handed to simdjson
+      if (sample && unif_rand() >= prob) continue;
+
+      simdjson::ondemand::document doc = parser.iterate(line.data(), line.size(), reader.capacity());
+      simdjson::ondemand::value value = doc;
+      collector.add_element(value);
+    }
+  }
+
+  return collector.fields_spec("");
+}
@@ -6,22 +6,138 @@
 #include "cpp11/simdjson.cpp"
 #include "cpp11/simdjson.h"
 #include <cpp11/parse_spec.hpp>
+#include <cpp11/simdjson_kernel.hpp>
 #endif
 
 
+[[cpp11::init]]
+void init_nested_df_class(DllInfo* dll) {
+  register_nested_df_class(dll);
+}
+
 [[cpp11::register]]
 cpp11::sexp parse_json(cpp11::strings json, cpp11::list spec) {
   cpp11::strings json_strings = cpp11::strings(json);
   cpp11::list spec_list = cpp11::list(spec);
   simdjson::ondemand::parser parser;
-  simdjson::padded_string content = simdjson::padded_string(std::string_view(std::string(json_strings[0])));
+  simdjson::padded_string content = padded_json(json_strings);
   simdjson::ondemand::document doc = parser.iterate(content);
 
   simdjson::ondemand::value value = doc;
 
-  auto collector_ptr = parse_spec(spec_list);
+  bool use_stats = parse_stats_option(spec_list);
+  auto stats = Parse_Stats();
+  auto collector_ptr = parse_spec(spec_list, use_stats ? &stats : nullptr);
+  auto problems = Problems(parse_on_error(spec_list));
   auto path = JSON_Path();
-  auto parsed = (*collector_ptr).parse_json(value, path);
+  path.set_document(std::string_view(content.data(), content.size()));
+  path.set_problems(&problems);
+  Rng_State::Scope rng_scope;
+  SEXP result = PROTECT((*collector_ptr).parse_json(value, path));
+  SEXP parsed = PROTECT(alloc_data_table(result));
+  problems.attach_to(parsed);
+  if (use_stats) {
+    stats.set_parser_capacity(parser.capacity());
+    stats.attach_to(parsed);
+  }
 
+  UNPROTECT(2);
   return parsed;
 }
+
+// `json` is newline delimited JSON and `spec` the spec of a `df`
+[[cpp11::register]]
+cpp11::sexp parse_ndjson(cpp11::strings json, cpp11::list spec) {
+  cpp11::strings json_strings = cpp11::strings(json);
+  cpp11::list spec_list = cpp11::list(spec);
+  simdjson::ondemand::parser parser;
+  simdjson::padded_string content = padded_json(json_strings);
+
+  std::string type = cpp11::r_string(cpp11::strings(spec_list["type"])[0]);
+  if (type != "df") {
+    cpp11::stop("`spec` must have type \"df\" to parse newline delimited JSON.");
+  }
+
+  bool use_stats = parse_stats_option(spec_list);
+  auto stats = Parse_Stats();
+  Column_Stats* root_stats = use_stats ? stats.add("") : nullptr;
+  auto df_parser = parse_spec_collector_df(spec_list, use_stats ? &stats : nullptr);
+  df_parser.set_stats(root_stats);
+  auto problems = Problems(parse_on_error(spec_list));
+  auto path = JSON_Path();
+  path.set_problems(&problems);
+  Rng_State::Scope rng_scope;
+  SEXP result = PROTECT(df_parser.parse_ndjson(content, parser, path));
+  SEXP parsed = PROTECT(alloc_data_table(result));
+  problems.attach_to(parsed);
+  if (use_stats) {
+    count_r_memory(root_stats, parsed);
+    stats.set_parser_capacity(parser.capacity());
+    stats.attach_to(parsed);
+  }
+
+  UNPROTECT(2);
+  return parsed;
+}
+
+// Parses `json` with the df `spec` into the Arrow C data interface structs
+// behind `schema_xptr` and `array_xptr`, e.g. from
+// `nanoarrow::nanoarrow_allocate_schema()` and `nanoarrow_allocate_array()`.
+// Returns the problems for `on_error = "collect"`, otherwise `NULL`.
+[[cpp11::register]]
+cpp11::sexp parse_json_arrow(cpp11::strings json, cpp11::list spec, SEXP schema_xptr, SEXP array_xptr, bool dictionary) {
+  cpp11::strings json_strings = cpp11::strings(json);
+  cpp11::list spec_list = cpp11::list(spec);
+
+  std::string type = cpp11::r_string(cpp11::strings(spec_list["type"])[0]);
+  if (type != "df") {
+    cpp11::stop("`spec` must have type \"df\" to export to Arrow.");
+  }
+
+  auto schema = static_cast<ArrowSchema*>(R_ExternalPtrAddr(schema_xptr));
+  auto array = static_cast<ArrowArray*>(R_ExternalPtrAddr(array_xptr));
+  if (schema == nullptr || array == nullptr) {
+    cpp11::stop("`schema` and `array` must point to an ArrowSchema and an ArrowArray.");
+  }
+  if (schema->release != nullptr || array->release != nullptr) {
+    cpp11::stop("`schema` and `array` must not be initialized yet.");
+  }
+
+  simdjson::ondemand::parser parser;
+  simdjson::padded_string content = padded_json(json_strings);
+  simdjson::ondemand::document doc = parser.iterate(content);
+  simdjson::ondemand::value value = doc;
+
+  auto df_parser = parse_spec_collector_df(spec_list);
+  auto problems = Problems(parse_on_error(spec_list));
+  auto path = JSON_Path();
+  path.set_document(std::string_view(content.data(), content.size()));
+  path.set_problems(&problems);
+
+  Rng_State::Scope rng_scope;
+  try {
+    df_parser.parse_json_arrow(value, path, dictionary, schema, array);
+  } catch (...) {
+    if (schema->release != nullptr) schema->release(schema);
+    if (array->release != nullptr) array->release(array);
+    throw;
+  }
+
+  if (problems.get_mode() != Error_Mode::collect) {
+    return R_NilValue;
+  }
+  return problems.get_value();
+}
+
+// the simdjson kernels compiled in, whether the CPU supports them and which
+// one is active
+[[cpp11::register]]
+cpp11::sexp simdjson_implementations() {
+  return simdjson_kernels();
+}
+
+// forces the kernel `name` for all following parses; returns the previous one
+[[cpp11::register]]
+std::string set_simdjson_implementation(std::string name) {
+  return set_simdjson_kernel(name);
+}